@@ -0,0 +1,311 @@
+#include "apm.h"
+#include "checker.h"
+#include "converter.h"
+#include "errors.h"
+#include "evaluator.h"
+#include "generator.h"
+#include "json.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "source.h"
+#include "synthetic.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Times each stage of the compiler separately on a synthetic program (or an existing
+// program), and reports the results as JSON so that they can be tracked for regressions.
+//
+// USAGE: gambit-bench [--entities N] [--enums N] [--enum-values N] [--overloads N] [--depth N]
+//                     [--program PATH] [--iterations N] [--warmup N]
+//                     [--output PATH] [--dump-program PATH]
+
+// Phases
+
+enum Phase
+{
+    LEXER,
+    PARSER,
+    RESOLVER,
+    CHECKER,
+    EVALUATOR,
+    CONVERTER,
+    GENERATOR,
+    PHASE_COUNT
+};
+
+const string phase_name[PHASE_COUNT] = {
+    "lexer",
+    "parser",
+    "resolver",
+    "checker",
+    "evaluator",
+    "converter",
+    "generator",
+};
+
+struct Sample
+{
+    double phase_ms[PHASE_COUNT];
+    size_t token_count;
+    size_t output_length;
+};
+
+using Clock = chrono::steady_clock;
+
+double milliseconds_since(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Compile
+
+// Runs the entire compiler over `content`. Each stage has to be repeated, as the Resolver
+// modifies the APM that the Parser produces, and so its result cannot be reused.
+Sample compile(const string &file_path, const string &content)
+{
+    Sample sample;
+    Source source(file_path, content);
+
+    auto start = Clock::now();
+    Lexer lexer;
+    lexer.tokenise(source);
+    sample.phase_ms[LEXER] = milliseconds_since(start);
+    sample.token_count = source.tokens.size();
+
+    start = Clock::now();
+    Parser parser;
+    auto program = parser.parse(source);
+    sample.phase_ms[PARSER] = milliseconds_since(start);
+
+    start = Clock::now();
+    Resolver resolver;
+    resolver.resolve(source, program);
+    sample.phase_ms[RESOLVER] = milliseconds_since(start);
+
+    start = Clock::now();
+    Checker checker;
+    checker.check(source, program);
+    sample.phase_ms[CHECKER] = milliseconds_since(start);
+
+    if (source.errors.size() > 0)
+    {
+        string msg = "The program being benchmarked contains errors.";
+        for (auto error : source.errors)
+            msg += "\n" + present_error(&source, error);
+        throw CompilerError(msg);
+    }
+
+    start = Clock::now();
+    Evaluator evaluator;
+    evaluator.evaluate(program);
+    sample.phase_ms[EVALUATOR] = milliseconds_since(start);
+
+    start = Clock::now();
+    Converter converter;
+    auto representation = converter.convert(program);
+    sample.phase_ms[CONVERTER] = milliseconds_since(start);
+
+    start = Clock::now();
+    // Generated code is discarded, so that the benchmark measures generation rather than I/O
+    ostream discard(nullptr);
+    Generator generator;
+    sample.output_length = generator.generate(representation, discard);
+    sample.phase_ms[GENERATOR] = milliseconds_since(start);
+
+    return sample;
+}
+
+// Statistics
+
+struct Statistics
+{
+    double min;
+    double median;
+    double mean;
+    double max;
+};
+
+Statistics summarise(vector<double> values)
+{
+    sort(values.begin(), values.end());
+
+    Statistics stats;
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.mean = accumulate(values.begin(), values.end(), 0.0) / values.size();
+
+    size_t middle = values.size() / 2;
+    stats.median = (values.size() % 2 == 1)
+                       ? values[middle]
+                       : (values[middle - 1] + values[middle]) / 2;
+
+    return stats;
+}
+
+void add_statistics(JsonContainer &json, const Statistics &stats)
+{
+    json.add("min_ms", stats.min);
+    json.add("median_ms", stats.median);
+    json.add("mean_ms", stats.mean);
+    json.add("max_ms", stats.max);
+}
+
+// Main
+
+size_t parse_count(const string &flag, const string &value)
+{
+    try
+    {
+        size_t end;
+        auto count = stoull(value, &end);
+        if (end == value.length())
+            return (size_t)count;
+    }
+    catch (const exception &)
+    {
+    }
+
+    throw CompilerError("Expected a number after " + flag + ", got '" + value + "'");
+}
+
+int main(int argc, char *argv[])
+{
+    SyntheticProgramOptions options;
+    optional<string> program_path;
+    optional<string> output_path;
+    optional<string> dump_path;
+    size_t iterations = 10;
+    size_t warmup = 1;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string flag = argv[i];
+            if (i + 1 >= argc)
+                throw CompilerError("Expected a value after " + flag);
+            string value = argv[++i];
+
+            if (flag == "--entities")
+                options.entities = parse_count(flag, value);
+            else if (flag == "--enums")
+                options.enums = parse_count(flag, value);
+            else if (flag == "--enum-values")
+                options.enum_values = parse_count(flag, value);
+            else if (flag == "--overloads")
+                options.overloads = parse_count(flag, value);
+            else if (flag == "--depth")
+                options.depth = parse_count(flag, value);
+            else if (flag == "--iterations")
+                iterations = max(parse_count(flag, value), (size_t)1);
+            else if (flag == "--warmup")
+                warmup = parse_count(flag, value);
+            else if (flag == "--program")
+                program_path = value;
+            else if (flag == "--output")
+                output_path = value;
+            else if (flag == "--dump-program")
+                dump_path = value;
+            else
+                throw CompilerError("Unrecognised argument " + flag);
+        }
+
+        // Program
+        string file_path = program_path.has_value() ? program_path.value() : "synthetic.gambit";
+        string content = program_path.has_value()
+                             ? Source(program_path.value()).content
+                             : generate_synthetic_program(options);
+
+        if (dump_path.has_value())
+        {
+            ofstream dump(dump_path.value());
+            dump << content;
+        }
+
+        // Run
+        for (size_t i = 0; i < warmup; i++)
+            compile(file_path, content);
+
+        vector<Sample> samples;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            samples.emplace_back(compile(file_path, content));
+            cerr << "\rIteration " << (i + 1) << "/" << iterations << flush;
+        }
+        cerr << endl;
+
+        // Report
+        JsonContainer json;
+        json.object();
+        json.add("benchmark", string("compiler-phases"));
+        json.add("iterations", iterations);
+
+        json.object("program");
+        json.add("source", file_path);
+        if (!program_path.has_value())
+        {
+            json.add("entities", options.entities);
+            json.add("enums", options.enums);
+            json.add("enum_values", options.enum_values);
+            json.add("overloads", options.overloads);
+            json.add("depth", options.depth);
+        }
+        json.add("bytes", content.length());
+        json.add("lines", (size_t)count(content.begin(), content.end(), '\n'));
+        json.add("tokens", samples.front().token_count);
+        json.add("output_bytes", samples.front().output_length);
+        json.close();
+
+        json.array("phases");
+        vector<double> totals(samples.size(), 0.0);
+        for (size_t phase = 0; phase < PHASE_COUNT; phase++)
+        {
+            vector<double> values;
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                values.push_back(samples[i].phase_ms[phase]);
+                totals[i] += samples[i].phase_ms[phase];
+            }
+
+            json.object();
+            json.add("phase", phase_name[phase]);
+            add_statistics(json, summarise(values));
+            json.close();
+        }
+        json.close();
+
+        json.object("total");
+        add_statistics(json, summarise(totals));
+        json.close();
+
+        json.close();
+
+        if (output_path.has_value())
+        {
+            ofstream output(output_path.value());
+            if (!output.is_open())
+                throw CompilerError("Could not open " + output_path.value());
+            output << (string)json << endl;
+            cerr << "Saved benchmark results to " << output_path.value() << endl;
+        }
+        else
+        {
+            cout << (string)json << endl;
+        }
+    }
+    catch (CompilerError &error)
+    {
+        cerr << "BENCHMARK ERROR: " << error.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "synthetic.h"
+
+// NOTE: The generated programs only use language features that every stage of the compiler
+//       is able to handle, so that a benchmark can time all of them. If the compiler starts
+//       reporting errors for a generated program, the benchmark will refuse to run.
+
+static string indent(size_t level)
+{
+    return string(level * 4, ' ');
+}
+
+static string enum_identity(size_t e)
+{
+    return "Enum" + to_string(e);
+}
+
+static string enum_value_identity(size_t e, size_t v)
+{
+    return "E" + to_string(e) + "_V" + to_string(v);
+}
+
+static string entity_identity(size_t e)
+{
+    return "Entity" + to_string(e);
+}
+
+// A condition on the state of `subject` that differs at every level of nesting
+static string condition(const SyntheticProgramOptions &options, const string &subject, size_t level)
+{
+    if (options.enums == 0 || options.enum_values == 0)
+        return subject + ".counter == " + to_string(level);
+
+    size_t e = level % options.enums;
+    size_t v = level % options.enum_values;
+    return subject + ".enum_" + to_string(e) + " == " + enum_value_identity(e, v);
+}
+
+static void write_nested_body(string &program, const SyntheticProgramOptions &options, const string &subject, size_t level, const string &innermost)
+{
+    if (level >= options.depth)
+    {
+        program += indent(level + 1) + innermost + "\n";
+        return;
+    }
+
+    // Alternate between if statements and loops, so that both kinds of code block are exercised
+    if (level % 2 == 0)
+    {
+        program += indent(level + 1) + "if " + condition(options, subject, level) + " {\n";
+        write_nested_body(program, options, subject, level + 1, innermost);
+        program += indent(level + 1) + "} else {\n";
+        program += indent(level + 2) + subject + ".counter = " + to_string(level) + "\n";
+        program += indent(level + 1) + "}\n";
+    }
+    else
+    {
+        program += indent(level + 1) + "loop {\n";
+        write_nested_body(program, options, subject, level + 1, innermost);
+        program += indent(level + 1) + "}\n";
+    }
+}
+
+string generate_synthetic_program(const SyntheticProgramOptions &options)
+{
+    string program;
+
+    program += "// Synthetic program";
+    program += " (entities: " + to_string(options.entities);
+    program += ", enums: " + to_string(options.enums);
+    program += ", enum values: " + to_string(options.enum_values);
+    program += ", overloads: " + to_string(options.overloads);
+    program += ", depth: " + to_string(options.depth) + ")\n\n";
+
+    // Enums
+    for (size_t e = 0; e < options.enums; e++)
+    {
+        program += "enum " + enum_identity(e) + " { ";
+        for (size_t v = 0; v < options.enum_values; v++)
+        {
+            if (v > 0)
+                program += ", ";
+            program += enum_value_identity(e, v);
+        }
+        program += " }\n";
+    }
+    program += "\n";
+
+    // Entities and their state
+    for (size_t i = 0; i < options.entities; i++)
+    {
+        auto entity = entity_identity(i);
+        program += "entity " + entity + "\n";
+        program += "state int (" + entity + " subject).counter\n";
+        for (size_t e = 0; e < options.enums; e++)
+            program += "state " + enum_identity(e) + " (" + entity + " subject).enum_" + to_string(e) + "\n";
+        program += "\n";
+    }
+
+    // Overloaded properties
+    for (size_t o = 0; o < options.overloads; o++)
+    {
+        for (size_t i = 0; i < options.entities; i++)
+        {
+            program += "fn int (" + entity_identity(i) + " subject).overload_" + to_string(o) + " {\n";
+            write_nested_body(program, options, "subject", 0, "return " + to_string(o));
+            program += indent(1) + "return 0\n";
+            program += "}\n\n";
+        }
+    }
+
+    // Procedures
+    for (size_t i = 0; i < options.entities; i++)
+    {
+        program += "update_" + to_string(i) + "() {\n";
+        program += indent(1) + entity_identity(i) + " subject\n";
+        write_nested_body(program, options, "subject", 0, "subject.counter = 1");
+        program += "}\n\n";
+    }
+
+    // Main
+    program += "main() {\n";
+    for (size_t i = 0; i < options.entities; i++)
+        program += indent(1) + entity_identity(i) + " entity_" + to_string(i) + "\n";
+
+    program += indent(1) + "loop {\n";
+    for (size_t i = 0; i < options.entities; i++)
+    {
+        auto subject = "entity_" + to_string(i);
+        for (size_t o = 0; o < options.overloads; o++)
+        {
+            program += indent(2) + "if " + subject + ".overload_" + to_string(o) + " == " + to_string(o) + " {\n";
+            program += indent(3) + subject + ".counter = " + to_string(o) + "\n";
+            program += indent(2) + "}\n";
+        }
+    }
+    program += indent(2) + "draw\n";
+    program += indent(1) + "}\n";
+    program += "}\n";
+
+    return program;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <string>
+using namespace std;
+
+// Controls the size and shape of a generated program.
+//
+// Each entity is given a state property for every enum (so the number of state properties
+// grows with `entities * enums`), and every overloaded property is declared once for every
+// entity (so each overloaded identity has `entities` overloads). `depth` is how deeply the
+// bodies of properties and of `main` nest their statements.
+struct SyntheticProgramOptions
+{
+    size_t entities = 8;
+    size_t enums = 4;
+    size_t enum_values = 4;
+    size_t overloads = 4;
+    size_t depth = 4;
+};
+
+string generate_synthetic_program(const SyntheticProgramOptions &options);
+
+#endif
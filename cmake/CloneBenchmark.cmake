@@ -0,0 +1,48 @@
+# CloneBenchmark.cmake
+#
+# Compiles sample games to C++, builds them against the runtime, and reports how quickly each
+# game's state can be cloned. Invoked by the `clone-benchmark` target.
+#
+# Expects GAMBIT_EXECUTABLE, GAMBIT_SOURCE_DIR, GAMBIT_CXX_COMPILER and GAMBIT_WORK_DIR to be defined.
+
+set(games
+    game/tic-tac-toe/simple
+    game/card-attack/main
+)
+
+foreach(game IN LISTS games)
+    # The compiler writes its output to `local/`, relative to the working directory.
+    string(REPLACE "/" "-" game_name "${game}")
+    set(work_dir "${GAMBIT_WORK_DIR}/${game_name}")
+    file(MAKE_DIRECTORY "${work_dir}/local")
+
+    execute_process(
+        COMMAND "${GAMBIT_EXECUTABLE}" "${GAMBIT_SOURCE_DIR}/${game}"
+        WORKING_DIRECTORY "${work_dir}"
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+        ERROR_QUIET
+    )
+
+    if(NOT result EQUAL 0 OR NOT EXISTS "${work_dir}/local/generated.cpp")
+        message(WARNING "Could not compile ${game} with the Gambit compiler, skipping it")
+        continue()
+    endif()
+
+    execute_process(
+        COMMAND "${GAMBIT_CXX_COMPILER}" -std=c++17 -O2 -pthread -I "${GAMBIT_SOURCE_DIR}/runtime"
+            "${work_dir}/local/generated.cpp" -o "${work_dir}/game"
+        RESULT_VARIABLE result
+    )
+
+    if(NOT result EQUAL 0)
+        message(WARNING "Could not build the generated program for ${game}, skipping it")
+        continue()
+    endif()
+
+    message(STATUS "Cloning the state of ${game}")
+    execute_process(
+        COMMAND "${work_dir}/game" --benchmark-clone
+        RESULT_VARIABLE result
+    )
+endforeach()
@@ -0,0 +1,58 @@
+# PgoTrain.cmake
+#
+# Runs an instrumented build of the compiler over every sample program in `game` and `test`,
+# so that the profile it records reflects real compilations. Invoked by the `pgo-train` target.
+#
+# Expects GAMBIT_EXECUTABLE, GAMBIT_SOURCE_DIR and GAMBIT_PGO_DIR to be defined.
+# When building with Clang, GAMBIT_LLVM_PROFDATA is used to merge the raw profiles.
+
+file(GLOB_RECURSE samples
+    "${GAMBIT_SOURCE_DIR}/game/*.gambit"
+    "${GAMBIT_SOURCE_DIR}/test/*.gambit"
+)
+
+if(NOT samples)
+    message(FATAL_ERROR "No sample programs found to train the compiler on.")
+endif()
+
+# The compiler writes its output to `local/`, relative to the working directory.
+set(work_dir "${GAMBIT_PGO_DIR}/train")
+file(MAKE_DIRECTORY "${work_dir}/local")
+
+foreach(sample IN LISTS samples)
+    # The compiler expects the path of the program without the `.gambit` extension.
+    string(REGEX REPLACE "\\.gambit$" "" sample_path "${sample}")
+    file(RELATIVE_PATH sample_name "${GAMBIT_SOURCE_DIR}" "${sample}")
+    message(STATUS "Training on ${sample_name}")
+
+    execute_process(
+        COMMAND "${GAMBIT_EXECUTABLE}" "${sample_path}"
+        WORKING_DIRECTORY "${work_dir}"
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+        ERROR_QUIET
+    )
+
+    if(NOT result EQUAL 0)
+        message(WARNING "Compiler exited with '${result}' while compiling ${sample_name}")
+    endif()
+endforeach()
+
+# Clang writes raw profiles that must be merged before they can be used.
+file(GLOB raw_profiles "${GAMBIT_PGO_DIR}/*.profraw")
+if(raw_profiles)
+    if(NOT GAMBIT_LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is required to merge the profiles recorded by Clang.")
+    endif()
+
+    execute_process(
+        COMMAND "${GAMBIT_LLVM_PROFDATA}" merge "-output=${GAMBIT_PGO_DIR}/gambit.profdata" ${raw_profiles}
+        RESULT_VARIABLE result
+    )
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Could not merge profiles with llvm-profdata.")
+    endif()
+endif()
+
+message(STATUS "Profile written to ${GAMBIT_PGO_DIR}")
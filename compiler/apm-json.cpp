@@ -283,6 +283,7 @@ string to_json(const ptr<StateProperty> &node, const size_t &depth)
     STRUCT_PTR_FIELD(scope);
     STRUCT_PTR_FIELD(parameters);
     STRUCT_PTR_FIELD(initial_value);
+    STRUCT_PTR_FIELD(hidden);
     json.close();
     return (string)json;
 }
@@ -412,6 +413,9 @@ string to_json(const Expression &node, const size_t &depth)
     VARIANT_PTR(InstanceList);
     VARIANT_PTR(IndexWithExpression);
     VARIANT_PTR(IndexWithIdentity);
+    VARIANT_PTR(EntitySelector);
+
+    VARIANT_PTR(ListOperation);
 
     VARIANT_PTR(Call);
     VARIANT_PTR(PropertyAccess);
@@ -502,6 +506,42 @@ string to_json(const ptr<IndexWithIdentity> &node, const size_t &depth)
     return (string)json;
 }
 
+string to_json(const ptr<EntitySelector> &node, const size_t &depth)
+{
+    JsonContainer json(depth);
+    json.object();
+    json.add("node", string("EntitySelector"));
+
+    if (node->entity_type)
+        json.add("subject", node->entity_type->identity);
+    else
+        STRUCT_PTR_FIELD(subject);
+
+    if (IS_PTR(node->property, StateProperty))
+        json.add("property", AS_PTR(node->property, StateProperty)->identity);
+    else if (IS_PTR(node->property, FunctionProperty))
+        json.add("property", AS_PTR(node->property, FunctionProperty)->identity);
+    else
+        STRUCT_PTR_FIELD(property)
+
+    STRUCT_PTR_FIELD(value);
+    json.close();
+    return (string)json;
+}
+
+string to_json(const ptr<ListOperation> &node, const size_t &depth)
+{
+    JsonContainer json(depth);
+    json.object();
+    json.add("node", string("ListOperation"));
+    STRUCT_PTR_FIELD(op);
+    STRUCT_PTR_FIELD(list);
+    STRUCT_PTR_FIELD(variable);
+    STRUCT_PTR_FIELD(body);
+    json.close();
+    return (string)json;
+}
+
 string to_json(const ptr<Call> &node, const size_t &depth)
 {
     JsonContainer json(depth);
@@ -551,6 +591,7 @@ string to_json(const ptr<ChooseExpression> &node, const size_t &depth)
     STRUCT_PTR_FIELD(player);
     STRUCT_PTR_FIELD(choices);
     STRUCT_PTR_FIELD(prompt);
+    STRUCT_PTR_FIELD(count);
     json.close();
     return (string)json;
 }
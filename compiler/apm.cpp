@@ -2,6 +2,7 @@
 #include "errors.h"
 #include "intrinsic.h"
 #include "source.h"
+#include "stats.h"
 
 // DECLARATION AND FETCHING
 
@@ -40,11 +41,13 @@ string identity_of(Scope::LookupValue value)
 
 bool directly_declared_in_scope(ptr<Scope> scope, string identity)
 {
+    Instrument::count(Instrument::scope_lookup_steps);
     return scope->lookup.find(identity) != scope->lookup.end();
 }
 
 bool declared_in_scope(ptr<Scope> scope, string identity)
 {
+    Instrument::count(Instrument::scope_lookups);
     while (!directly_declared_in_scope(scope, identity) && !scope->parent.expired())
         scope = ptr<Scope>(scope->parent);
 
@@ -59,6 +62,7 @@ bool is_overloadable(Scope::LookupValue value)
 
 Scope::LookupValue fetch(ptr<Scope> scope, string identity)
 {
+    Instrument::count(Instrument::scope_lookups);
     while (!directly_declared_in_scope(scope, identity) && !scope->parent.expired())
         scope = ptr<Scope>(scope->parent);
 
@@ -70,6 +74,7 @@ Scope::LookupValue fetch(ptr<Scope> scope, string identity)
 
 vector<Scope::LookupValue> fetch_all_overloads(ptr<Scope> scope, string identity)
 {
+    Instrument::count(Instrument::scope_lookups);
     vector<Scope::LookupValue> overloads;
 
     while (true)
@@ -161,6 +166,9 @@ Pattern determine_expression_pattern(Expression expression)
         if (op == "+")
             return determine_expression_pattern(unary->value);
 
+        if (op == "#")
+            return Intrinsic::type_amt;
+
         // If the value is `int` or `amt`, the pattern should actually be `int`
         if (op == "-")
             return Intrinsic::type_num;
@@ -183,6 +191,11 @@ Pattern determine_expression_pattern(Expression expression)
     {
         auto index_with_expression = AS_PTR(expression, IndexWithExpression);
         auto subject_pattern = determine_expression_pattern(index_with_expression->subject);
+
+        // The checker reports indexes into values that are not lists
+        if (!is_pattern_list(subject_pattern))
+            return CREATE(InvalidPattern);
+
         return determine_pattern_of_contents_of(subject_pattern);
     }
 
@@ -196,9 +209,54 @@ Pattern determine_expression_pattern(Expression expression)
         throw CompilerError("Cannot determine pattern of expression before identities have been resolved.", index_with_expression->span);
     }
 
+    if (IS_PTR(expression, EntitySelector))
+    {
+        auto entity_selector = AS_PTR(expression, EntitySelector);
+        if (IS_PTR(entity_selector->property, InvalidProperty))
+            return CREATE(InvalidPattern);
+        if (!entity_selector->entity_type)
+            throw CompilerError("Cannot determine pattern of EntitySelector expression before identities have been resolved.", entity_selector->span);
+
+        // There may be no entity with the value
+        auto union_pattern = CREATE(UnionPattern);
+        union_pattern->patterns.push_back(entity_selector->entity_type);
+        union_pattern->patterns.push_back(Intrinsic::none_val);
+        return union_pattern;
+    }
+
+    // List operations
+    if (IS_PTR(expression, ListOperation))
+    {
+        auto list_operation = AS_PTR(expression, ListOperation);
+        auto list_pattern = determine_expression_pattern(list_operation->list);
+        if (IS_PTR(list_pattern, PatternLiteral))
+            list_pattern = AS_PTR(list_pattern, PatternLiteral)->pattern;
+
+        // The checker reports list operations on values that are not lists
+        if (!is_pattern_list(list_pattern))
+            return CREATE(InvalidPattern);
+
+        auto list_type = CREATE(ListType);
+        if (list_operation->op == "filter")
+        {
+            list_type->list_of = determine_pattern_of_contents_of(list_pattern);
+        }
+        else
+        {
+            // Mapping a list keeps its size
+            list_type->list_of = determine_expression_pattern(list_operation->body);
+            list_type->fixed_size = determine_fixed_size_of(list_pattern);
+        }
+        return list_type;
+    }
+
     // Calls
     if (IS_PTR(expression, Call))
     {
+        // Procedures do not have a value
+        if (AS_PTR(expression, Call)->procedure)
+            return Intrinsic::none_val;
+
         // TODO: Return the correct pattern
         return CREATE(AnyPattern);
     }
@@ -227,6 +285,18 @@ Pattern determine_expression_pattern(Expression expression)
     {
         auto choose_expression = AS_PTR(expression, ChooseExpression);
         auto choices_pattern = determine_expression_pattern(choose_expression->choices);
+
+        // The checker reports choices that are not lists
+        if (!is_pattern_list(choices_pattern))
+            return CREATE(InvalidPattern);
+
+        if (choose_expression->count.has_value())
+        {
+            auto list_type = CREATE(ListType);
+            list_type->list_of = determine_pattern_of_contents_of(choices_pattern);
+            list_type->fixed_size = choose_expression->count;
+            return list_type;
+        }
         return determine_pattern_of_contents_of(choices_pattern);
     }
 
@@ -282,6 +352,15 @@ Pattern determine_pattern_of_contents_of(Pattern pattern)
         return AS_PTR(pattern, ListType)->list_of;
     }
 
+    // Union of list types, such as the pattern of a value from a list of list literals
+    if (IS_PTR(pattern, UnionPattern) && is_pattern_list(pattern))
+    {
+        vector<Pattern> contents;
+        for (auto sub_pattern : AS_PTR(pattern, UnionPattern)->patterns)
+            contents.push_back(determine_pattern_of_contents_of(sub_pattern));
+        return create_union_pattern(contents);
+    }
+
     // Invalid pattern
     if (IS_PTR(pattern, InvalidPattern))
     {
@@ -291,6 +370,35 @@ Pattern determine_pattern_of_contents_of(Pattern pattern)
     throw CompilerError("Cannot determine pattern of pattern's contents as said pattern is not a list type.");
 }
 
+// NOTE: A union of list types only has a fixed size if every list in the union has the same fixed size.
+optional<Expression> determine_fixed_size_of(Pattern pattern)
+{
+    if (IS_PTR(pattern, PatternLiteral))
+        return determine_fixed_size_of(AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, ListType))
+        return AS_PTR(pattern, ListType)->fixed_size;
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        optional<Expression> fixed_size;
+        for (auto sub_pattern : AS_PTR(pattern, UnionPattern)->patterns)
+        {
+            auto sub_size = determine_fixed_size_of(sub_pattern);
+            if (!sub_size.has_value() || !IS_PTR(sub_size.value(), PrimitiveValue))
+                return {};
+
+            if (fixed_size.has_value() && AS_PTR(fixed_size.value(), PrimitiveValue)->value != AS_PTR(sub_size.value(), PrimitiveValue)->value)
+                return {};
+
+            fixed_size = sub_size;
+        }
+        return fixed_size;
+    }
+
+    return {};
+}
+
 Pattern create_union_pattern(vector<Pattern> patterns)
 {
     vector<Pattern> reduced_patterns;
@@ -521,6 +629,27 @@ bool is_pattern_optional(Pattern pattern)
     return false;
 }
 
+// NOTE: Invalid patterns are considered to be lists, so that an error is not reported twice.
+bool is_pattern_list(Pattern pattern)
+{
+    if (IS_PTR(pattern, PatternLiteral))
+        return is_pattern_list(AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, ListType) || IS_PTR(pattern, InvalidPattern))
+        return true;
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        auto union_pattern = AS_PTR(pattern, UnionPattern);
+        for (auto sub_pattern : union_pattern->patterns)
+            if (!is_pattern_list(sub_pattern))
+                return false;
+        return union_pattern->patterns.size() > 0;
+    }
+
+    return false;
+}
+
 bool does_instance_list_match_parameters(ptr<InstanceList> instance_list, vector<ptr<Variable>> parameters)
 {
     auto values = instance_list->values;
@@ -628,6 +757,10 @@ Span get_span(Expression expr)
         return AS_PTR(expr, IndexWithExpression)->span;
     if (IS_PTR(expr, IndexWithIdentity))
         return AS_PTR(expr, IndexWithIdentity)->span;
+    if (IS_PTR(expr, EntitySelector))
+        return AS_PTR(expr, EntitySelector)->span;
+    if (IS_PTR(expr, ListOperation))
+        return AS_PTR(expr, ListOperation)->span;
 
     if (IS_PTR(expr, Call))
         return AS_PTR(expr, Call)->span;
@@ -118,6 +118,9 @@ struct Binary;
 struct InstanceList;
 struct IndexWithExpression;
 struct IndexWithIdentity;
+struct EntitySelector;
+
+struct ListOperation;
 
 struct Call;
 struct PropertyAccess;
@@ -148,6 +151,10 @@ using Expression = variant<
     ptr<InstanceList>,
     ptr<IndexWithExpression>,
     ptr<IndexWithIdentity>,
+    ptr<EntitySelector>,
+
+    // List operations
+    ptr<ListOperation>,
 
     // Calls
     ptr<Call>,
@@ -330,6 +337,9 @@ struct StateProperty
     ptr<Scope> scope;
     vector<ptr<Variable>> parameters;
     optional<Expression> initial_value;
+
+    // Hidden state is only seen by the player it belongs to, or by no one if it does not belong to a player
+    bool hidden = false;
 };
 
 struct FunctionProperty
@@ -424,6 +434,30 @@ struct IndexWithIdentity
     ptr<IdentityLiteral> index;
 };
 
+// NOTE: An entity selector, such as `Player[mark: X]`, evaluates to the entity of a type whose
+//       property has the given value, or to `none` if there is no such entity.
+struct EntitySelector
+{
+    Span span;
+    Expression subject; // The identity of the entity type, as it was parsed
+    Property property;
+    Expression value;
+
+    ptr<EntityType> entity_type = nullptr; // Set once the subject has been resolved
+};
+
+// NOTE: A list operation, such as `xs filter (x: x > 0)` or `xs map (x: x * 2)`, evaluates its
+//       body once for each value of the list, with the value bound to its variable.
+struct ListOperation
+{
+    Span span;
+    string op; // FIXME: Make this an enum instead of a string
+    Expression list;
+    ptr<Variable> variable;
+    ptr<Scope> scope; // The scope of the variable, whose parent is set by the resolver
+    Expression body;
+};
+
 struct Call
 {
     Span span;
@@ -436,6 +470,9 @@ struct Call
     };
     Expression callee;
     vector<Argument> arguments;
+    // FIXME: Callees are not resolved yet, so only intrinsic procedures can be called, which are
+    //        looked up by the identity of the callee.
+    ptr<Procedure> procedure = nullptr;
 };
 
 struct PropertyAccess
@@ -451,6 +488,7 @@ struct ChooseExpression
     Expression player;
     Expression choices;
     Expression prompt;
+    optional<Expression> count; // When set, a list of `count` different choices is chosen
 };
 
 struct IfExpression
@@ -561,10 +599,12 @@ identity_of(Scope::LookupValue value);
 // Pattern analysis
 [[nodiscard]] Pattern determine_expression_pattern(Expression expr);
 [[nodiscard]] Pattern determine_pattern_of_contents_of(Pattern pattern);
+[[nodiscard]] optional<Expression> determine_fixed_size_of(Pattern pattern);
 [[nodiscard]] Pattern create_union_pattern(vector<Pattern> patterns);
 [[nodiscard]] bool is_pattern_subset_of_superset(Pattern subset, Pattern superset);
 [[nodiscard]] bool do_patterns_overlap(Pattern a, Pattern b);
 [[nodiscard]] bool is_pattern_optional(Pattern pattern);
+[[nodiscard]] bool is_pattern_list(Pattern pattern);
 [[nodiscard]] bool does_instance_list_match_parameters(ptr<InstanceList> instance_list, vector<ptr<Variable>> parameters);
 
 // Spans
@@ -633,6 +673,9 @@ string to_json(const ptr<Binary> &node, const size_t &depth = 0);
 string to_json(const ptr<InstanceList> &node, const size_t &depth = 0);
 string to_json(const ptr<IndexWithExpression> &node, const size_t &depth = 0);
 string to_json(const ptr<IndexWithIdentity> &node, const size_t &depth = 0);
+string to_json(const ptr<EntitySelector> &node, const size_t &depth = 0);
+
+string to_json(const ptr<ListOperation> &node, const size_t &depth = 0);
 
 string to_json(const ptr<Call> &node, const size_t &depth = 0);
 string to_json(const Call::Argument &node, const size_t &depth = 0);
@@ -1,5 +1,6 @@
 #include "checker.h"
 #include "intrinsic.h"
+#include "trace.h"
 
 // TODO: Currently, I assume that the checker will never actually modify
 //       the APM, only read it. It may be worth formalising that assumption
@@ -18,6 +19,7 @@
 
 void Checker::check(Source &source, ptr<Program> program)
 {
+    TraceScope trace("Checker::check");
     this->source = &source;
     check_program(program);
 }
@@ -37,6 +39,7 @@ void Checker::check_scope(ptr<Scope> scope)
 
 void Checker::check_scope_lookup_value(Scope::LookupValue value, ptr<Scope> scope)
 {
+    TraceScope trace("Checker::check_scope_lookup_value", value);
 
     if (IS_PTR(value, Scope::OverloadedIdentity))
     {
@@ -216,6 +219,11 @@ void Checker::check_expression(Expression expr, ptr<Scope> scope)
         check_index_with_expression(AS_PTR(expr, IndexWithExpression), scope);
     else if (IS_PTR(expr, IndexWithIdentity))
         check_index_with_identity(AS_PTR(expr, IndexWithIdentity), scope);
+    else if (IS_PTR(expr, EntitySelector))
+        check_entity_selector(AS_PTR(expr, EntitySelector), scope);
+
+    else if (IS_PTR(expr, ListOperation))
+        check_list_operation(AS_PTR(expr, ListOperation), scope);
 
     else if (IS_PTR(expr, Call))
         check_call(AS_PTR(expr, Call), scope);
@@ -255,6 +263,10 @@ void Checker::check_call(ptr<Call> call, ptr<Scope> scope)
 
     for (auto &argument : call->arguments)
         check_expression(argument.value, scope);
+
+    // TODO: Check that the argument is a list
+    if (call->procedure == Intrinsic::procedure_shuffle && call->arguments.size() != 1)
+        source->log_error("`shuffle` takes a single list.", call->span);
 }
 
 void Checker::check_choose_expression(ptr<ChooseExpression> choose_expression, ptr<Scope> scope)
@@ -264,6 +276,17 @@ void Checker::check_choose_expression(ptr<ChooseExpression> choose_expression, p
     check_expression(choose_expression->choices, scope);
     check_expression(choose_expression->player, scope);
     check_expression(choose_expression->prompt, scope);
+
+    if (!is_pattern_list(determine_expression_pattern(choose_expression->choices)))
+        source->log_error("Choices must be a list. This value is not a list.", get_span(choose_expression->choices));
+
+    if (choose_expression->count.has_value())
+    {
+        auto count = choose_expression->count.value();
+        check_expression(count, scope);
+        if (!is_pattern_subset_of_superset(determine_expression_pattern(count), Intrinsic::type_int))
+            source->log_error("The number of values to choose must be a number.", get_span(count));
+    }
 }
 
 void Checker::check_if_expression(ptr<IfExpression> if_expression, ptr<Scope> scope)
@@ -301,7 +324,9 @@ void Checker::check_index_with_expression(ptr<IndexWithExpression> index_with_ex
     check_expression(index_with_expression->subject, scope);
     check_expression(index_with_expression->index, scope);
 
-    // TODO: Check that the subject is an array/list
+    if (!is_pattern_list(determine_expression_pattern(index_with_expression->subject)))
+        source->log_error("Only lists can be indexed. This value is not a list.", get_span(index_with_expression->subject));
+
     // TODO: Check that the index is an integer
 }
 
@@ -310,6 +335,40 @@ void Checker::check_index_with_identity(ptr<IndexWithIdentity> index_with_identi
     throw CompilerError("Attempt to check IndexWithIdentity expression. This should have already been resolved to a PropertyAccess or EnumValue");
 }
 
+void Checker::check_entity_selector(ptr<EntitySelector> entity_selector, ptr<Scope> scope)
+{
+    check_expression(entity_selector->value, scope);
+
+    Pattern property_pattern;
+    if (IS_PTR(entity_selector->property, StateProperty))
+        property_pattern = AS_PTR(entity_selector->property, StateProperty)->pattern;
+    else if (IS_PTR(entity_selector->property, FunctionProperty))
+        property_pattern = AS_PTR(entity_selector->property, FunctionProperty)->pattern;
+    else
+        return;
+
+    auto value_pattern = determine_expression_pattern(entity_selector->value);
+    if (!do_patterns_overlap(value_pattern, property_pattern))
+        source->log_error("No entity can be selected, as the value does not match the pattern of the property.", get_span(entity_selector->value));
+}
+
+void Checker::check_list_operation(ptr<ListOperation> list_operation, ptr<Scope> scope)
+{
+    check_expression(list_operation->list, scope);
+    check_expression(list_operation->body, list_operation->scope);
+
+    auto list_pattern = determine_expression_pattern(list_operation->list);
+    if (!is_pattern_list(list_pattern))
+        source->log_error("Only lists can be used with `" + list_operation->op + "`. This value is not a list.", get_span(list_operation->list));
+
+    if (list_operation->op == "filter")
+    {
+        auto body_pattern = determine_expression_pattern(list_operation->body);
+        if (!is_pattern_subset_of_superset(body_pattern, Intrinsic::type_bool))
+            source->log_error("The condition of a filter must evaluate either to true or false.", get_span(list_operation->body));
+    }
+}
+
 void Checker::check_property_access(ptr<PropertyAccess> property_access, ptr<Scope> scope)
 {
     check_expression(property_access->subject, scope);
@@ -318,7 +377,11 @@ void Checker::check_property_access(ptr<PropertyAccess> property_access, ptr<Sco
 void Checker::check_unary(ptr<Unary> unary, ptr<Scope> scope)
 {
     check_expression(unary->value, scope);
-    // TODO: Pattern check the operand
+
+    if (unary->op == "#" && !is_pattern_list(determine_expression_pattern(unary->value)))
+        source->log_error("Only lists can be counted with `#`. This value is not a list.", get_span(unary->value));
+
+    // TODO: Pattern check the other operands
 }
 
 void Checker::check_binary(ptr<Binary> binary, ptr<Scope> scope)
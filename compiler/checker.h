@@ -44,6 +44,9 @@ private:
     void check_instance_list(ptr<InstanceList> list, ptr<Scope> scope);
     void check_index_with_expression(ptr<IndexWithExpression> index_with_expression, ptr<Scope> scope);
     void check_index_with_identity(ptr<IndexWithIdentity> index_with_identity, ptr<Scope> scope);
+    void check_entity_selector(ptr<EntitySelector> entity_selector, ptr<Scope> scope);
+
+    void check_list_operation(ptr<ListOperation> list_operation, ptr<Scope> scope);
 
     void check_call(ptr<Call> call, ptr<Scope> scope);
     void check_property_access(ptr<PropertyAccess> property_access, ptr<Scope> scope);
@@ -1,23 +1,140 @@
 #include "errors.h"
 #include "converter.h"
+#include "intrinsic.h"
+#include "trace.h"
+#include <algorithm>
+
+// Identities that cannot be used in the generated C++ program
+static const unordered_set<string> reserved_identities = {
+    // Keywords
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+    "catch", "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr", "const_cast",
+    "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int",
+    "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+    "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+    "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+    "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+    "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+
+    // Standard library and runtime
+    "std", "gambit", "main", "int8_t", "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t",
+    "uint32_t", "uint64_t", "size_t", "NULL",
+
+    // Generated functions and variables
+    "gambit_setup", "gambit_play", "gambit_clone", "gambit_restore", "gambit_hash", "gambit_state", "GambitState", "gambit_index_0", "gambit_index_1", "gambit_index_2", "gambit_index_3", "gambit_arena",
+    "gambit_source", "gambit_result", "gambit_value", "gambit_entity"};
+
+// Expressions hold the types, targets and arguments they refer to in 32 bits, to stay small
+static uint32_t narrow(size_t index)
+{
+    if (index > UINT32_MAX)
+        throw CompilerError("Cannot convert a program with more than 2^32 types, arguments or targets - Not yet implemented.");
+
+    return (uint32_t)index;
+}
 
 C_Program Converter::convert(ptr<Program> program)
 {
+    TraceScope trace("Converter::convert");
+
+    this->program = program;
+
     // Reserve identities that will be used in the C program
-    identities_used.insert("GambitEntity");
-    identities_used.insert("main");
+    identities_used.insert(reserved_identities.begin(), reserved_identities.end());
 
-    // Convert everything in global scope
-    for (auto entry : program->global_scope->lookup)
+    // Declarations are converted in order of their identity, so that the generated
+    // program does not depend on the order of the global scope's hash map.
+    vector<string> identities;
+    for (const auto &entry : program->global_scope->lookup)
+        identities.push_back(entry.first);
+    sort(identities.begin(), identities.end());
+
+    vector<Scope::LookupValue> declarations;
+    for (const auto &identity : identities)
     {
-        auto value = entry.second;
-        if (IS_PTR(value, Procedure))
+        auto value = program->global_scope->lookup.at(identity);
+        if (IS_PTR(value, Scope::OverloadedIdentity))
+        {
+            for (auto overload : AS_PTR(value, Scope::OverloadedIdentity)->overloads)
+                declarations.push_back(overload);
+        }
+        else
+        {
+            declarations.push_back(value);
+        }
+    }
+
+    // Types
+    void_type = create_type(C_Type());
+
+    for (auto value : declarations)
+    {
+        if (!IS(value, Pattern))
+            continue;
+
+        auto pattern = AS(value, Pattern);
+        if (IS_PTR(pattern, EnumType))
+            convert_enum(AS_PTR(pattern, EnumType));
+        else if (IS_PTR(pattern, EntityType))
+            convert_entity(AS_PTR(pattern, EntityType));
+    }
+
+    // Functions are declared before anything is converted, so that they can be called from anywhere
+    for (auto value : declarations)
+    {
+        if (IS_PTR(value, FunctionProperty))
+            declare_function_property(AS_PTR(value, FunctionProperty));
+        else if (IS_PTR(value, Procedure) && AS_PTR(value, Procedure) != Intrinsic::procedure_shuffle)
+            declare_procedure(AS_PTR(value, Procedure));
+    }
+
+    // Intrinsic variables
+    for (auto value : declarations)
+    {
+        if (!IS_PTR(value, Variable))
+            continue;
+
+        auto variable = AS_PTR(value, Variable);
+        if (variable != Intrinsic::variable_game)
+            throw CompilerError("Cannot convert global variable '" + variable->identity + "' - Not yet implemented.", variable->span);
+
+        ir.intrinsics.game_variable = ir.variables.size();
+        variable_indices[variable] = ir.variables.size();
+        ir.variables.push_back({create_identity(variable->identity), convert_type(variable->pattern)});
+    }
+
+    // State
+    for (auto value : declarations)
+    {
+        if (IS_PTR(value, StateProperty))
+            convert_state_property(AS_PTR(value, StateProperty));
+    }
+
+    determine_entity_capacities();
+    choose_table_storage();
+    pack_state_properties();
+
+    // Function and procedure bodies. Function properties are converted first, as the return type of
+    // a function can be narrowed to the type of its value, which procedures then call it with.
+    for (auto value : declarations)
+    {
+        if (IS_PTR(value, FunctionProperty))
+            convert_function_property(AS_PTR(value, FunctionProperty));
+    }
+    for (auto value : declarations)
+    {
+        if (IS_PTR(value, Procedure) && AS_PTR(value, Procedure) != Intrinsic::procedure_shuffle)
             convert_procedure(AS_PTR(value, Procedure));
     }
 
-    return ir;
+    memoise_function_properties();
+
+    return std::move(ir);
 }
 
+// IDENTITIES
+
 string Converter::create_identity(string identity)
 {
     if (identities_used.find(identity) == identities_used.end())
@@ -26,28 +143,1039 @@ string Converter::create_identity(string identity)
         return identity;
     }
 
-    size_t identity_counter = 1;
-    string new_identity;
-    do
-    {
-        new_identity = identity + "_" + to_string(identity_counter++);
-    } while (identities_used.find(new_identity) != identities_used.end());
+    size_t identity_counter = 1;
+    string new_identity;
+    do
+    {
+        new_identity = identity + "_" + to_string(identity_counter++);
+    } while (identities_used.find(new_identity) != identities_used.end());
+
+    identities_used.insert(new_identity);
+    return new_identity;
+}
+
+// NOTE: Local identities only need to be unique within the function they are declared in,
+//       however they must also not shadow any global identity.
+string Converter::create_local_identity(string identity)
+{
+    auto is_used = [&](const string &identity)
+    {
+        return identities_used.find(identity) != identities_used.end() ||
+               local_identities_used.find(identity) != local_identities_used.end();
+    };
+
+    string new_identity = identity;
+    size_t identity_counter = 1;
+    while (is_used(new_identity))
+        new_identity = identity + "_" + to_string(identity_counter++);
+
+    local_identities_used.insert(new_identity);
+    return new_identity;
+}
+
+size_t Converter::intern_string_literal(string value)
+{
+    auto existing = string_literal_indices.find(value);
+    if (existing != string_literal_indices.end())
+        return existing->second;
+
+    size_t index = ir.string_literals.size();
+    string_literal_indices.emplace(value, index);
+    ir.string_literals.push_back(std::move(value));
+    return index;
+}
+
+// TYPES AND STORAGE
+
+size_t Converter::create_type(C_Type type)
+{
+    if (type.optional && (type.kind == C_Type::BOOL ||
+                          type.kind == C_Type::INT ||
+                          type.kind == C_Type::DOUBLE ||
+                          type.kind == C_Type::LIST))
+        throw CompilerError("Cannot convert optional bool, number and list patterns - Not yet implemented.");
+
+    for (size_t i = 0; i < ir.types.size(); i++)
+        if (ir.types[i] == type)
+            return i;
+
+    ir.types.push_back(type);
+    return ir.types.size() - 1;
+}
+
+size_t Converter::convert_type(Pattern pattern)
+{
+    C_Type type;
+
+    if (IS_PTR(pattern, PatternLiteral))
+        return convert_type(AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, PrimitiveValue))
+    {
+        auto primitive_value = AS_PTR(pattern, PrimitiveValue);
+        if (primitive_value != Intrinsic::none_val)
+            return convert_type(primitive_value->type);
+
+        type.kind = C_Type::VOID;
+        type.optional = true;
+    }
+
+    else if (IS_PTR(pattern, PrimitiveType))
+    {
+        auto primitive_type = AS_PTR(pattern, PrimitiveType);
+        if (primitive_type == Intrinsic::type_str)
+            type.kind = C_Type::STRING;
+        else if (primitive_type == Intrinsic::type_num)
+            type.kind = C_Type::DOUBLE;
+        else if (primitive_type == Intrinsic::type_int || primitive_type == Intrinsic::type_amt)
+            type.kind = C_Type::INT;
+        else if (primitive_type == Intrinsic::type_bool)
+            type.kind = C_Type::BOOL;
+        else if (primitive_type == Intrinsic::type_none)
+            type.optional = true;
+        else
+            throw CompilerError("Cannot convert PrimitiveType '" + primitive_type->identity + "' to a C type.");
+    }
+
+    else if (IS_PTR(pattern, EnumValue))
+    {
+        type.kind = C_Type::ENUM;
+        type.index = enum_indices.at(AS_PTR(pattern, EnumValue)->type);
+    }
+
+    else if (IS_PTR(pattern, EnumType))
+    {
+        type.kind = C_Type::ENUM;
+        type.index = enum_indices.at(AS_PTR(pattern, EnumType));
+    }
+
+    else if (IS_PTR(pattern, EntityType))
+    {
+        type.kind = C_Type::ENTITY;
+        type.index = entity_indices.at(AS_PTR(pattern, EntityType));
+    }
+
+    else if (IS_PTR(pattern, ListType))
+    {
+        auto list_type = AS_PTR(pattern, ListType);
+        type.kind = C_Type::LIST;
+        type.index = convert_type(list_type->list_of);
+        type.fixed_size = evaluate_fixed_size(list_type).value_or(0);
+    }
+
+    else if (IS_PTR(pattern, UnionPattern))
+    {
+        auto union_pattern = AS_PTR(pattern, UnionPattern);
+        if (union_pattern->patterns.size() == 0)
+            throw CompilerError("Cannot convert an empty UnionPattern to a C type.");
+
+        type = ir.types[convert_type(union_pattern->patterns[0])];
+        for (size_t i = 1; i < union_pattern->patterns.size(); i++)
+            type = merge_types(type, ir.types[convert_type(union_pattern->patterns[i])]);
+    }
+
+    else
+    {
+        throw CompilerError("Cannot convert Pattern variant to a C type.");
+    }
+
+    return create_type(type);
+}
+
+// Determines a type that can represent the values of both types
+C_Type Converter::merge_types(C_Type a, C_Type b)
+{
+    // `none` can be represented by any optional type
+    if (a.kind == C_Type::VOID && a.optional)
+    {
+        b.optional = true;
+        return b;
+    }
+    if (b.kind == C_Type::VOID && b.optional)
+    {
+        a.optional = true;
+        return a;
+    }
+
+    C_Type merged = a;
+    merged.optional = a.optional || b.optional;
+
+    if (a.kind == C_Type::LIST && b.kind == C_Type::LIST)
+    {
+        merged.index = create_type(merge_types(ir.types[a.index], ir.types[b.index]));
+        merged.fixed_size = (a.fixed_size == b.fixed_size) ? a.fixed_size : 0;
+        merged.capacity = (a.capacity == b.capacity) ? a.capacity : 0;
+        return merged;
+    }
+
+    if (a.kind == b.kind && a.index == b.index)
+        return merged;
+
+    bool a_is_number = a.kind == C_Type::INT || a.kind == C_Type::DOUBLE;
+    bool b_is_number = b.kind == C_Type::INT || b.kind == C_Type::DOUBLE;
+    if (a_is_number && b_is_number)
+    {
+        merged.kind = C_Type::DOUBLE;
+        return merged;
+    }
+
+    throw CompilerError("Cannot convert UnionPattern to a C type, as its patterns cannot be represented by a single type.");
+}
+
+// The resolver does not resolve the sizes of lists, so we only accept sizes that are literal numbers.
+optional<size_t> Converter::evaluate_fixed_size(ptr<ListType> list_type)
+{
+    if (!list_type->fixed_size.has_value())
+        return {};
+
+    auto fixed_size = list_type->fixed_size.value();
+    ptr<PrimitiveValue> value = nullptr;
+
+    if (IS(fixed_size, UnresolvedLiteral) && IS_PTR(AS(fixed_size, UnresolvedLiteral), PrimitiveLiteral))
+        value = AS_PTR(AS(fixed_size, UnresolvedLiteral), PrimitiveLiteral)->value;
+    else if (IS_PTR(fixed_size, ExpressionLiteral) && IS_PTR(AS_PTR(fixed_size, ExpressionLiteral)->expr, PrimitiveValue))
+        value = AS_PTR(AS_PTR(fixed_size, ExpressionLiteral)->expr, PrimitiveValue);
+    else if (IS_PTR(fixed_size, PrimitiveValue))
+        value = AS_PTR(fixed_size, PrimitiveValue);
+
+    if (value && IS(value->value, int) && AS(value->value, int) >= 0)
+        return (size_t)AS(value->value, int);
+
+    return {};
+}
+
+void Converter::convert_enum(ptr<EnumType> enum_type)
+{
+    C_Enum c_enum;
+    c_enum.identity = create_identity(enum_type->identity);
+    c_enum.names_identity = create_identity(enum_type->identity + "_names");
+
+    for (const auto &value : enum_type->values)
+    {
+        c_enum.values.push_back(create_identity(enum_type->identity + "_" + value->identity));
+        c_enum.names.push_back(value->identity);
+    }
+
+    enum_indices[enum_type] = ir.enums.size();
+    ir.enums.push_back(c_enum);
+}
+
+void Converter::convert_entity(ptr<EntityType> entity_type)
+{
+    C_Entity entity;
+    entity.identity = create_identity(entity_type->identity);
+    entity.name = entity_type->identity;
+    entity.storage = create_identity(entity_type->identity + "_storage");
+    entity.create_function = create_identity(entity_type->identity + "_create");
+    entity.capacity = 0;
+
+    if (entity_type == Intrinsic::entity_player)
+        ir.intrinsics.player_entity = ir.entities.size();
+    if (entity_type == Intrinsic::entity_game)
+        ir.intrinsics.game_entity = ir.entities.size();
+
+    entity_indices[entity_type] = ir.entities.size();
+    ir.entities.push_back(entity);
+}
+
+void Converter::convert_state_property(ptr<StateProperty> state_property)
+{
+    local_identities_used.clear();
+
+    C_StateProperty state;
+    state.type = convert_type(state_property->pattern);
+
+    // There is a player for each seat at the game, so the list of players has a fixed size
+    if (state_property == Intrinsic::state_game_players)
+    {
+        C_Type players_type = ir.types[state.type];
+        players_type.fixed_size = ir.intrinsics.player_count;
+        state.type = create_type(players_type);
+    }
+    for (auto parameter : state_property->parameters)
+        state.parameters.push_back(convert_variable(parameter));
+
+    if (state.parameters.empty())
+        throw CompilerError("Cannot convert state property '" + state_property->identity + "' without parameters - Not yet implemented.", state_property->span);
+
+    auto &first_parameter_type = ir.types[ir.variables[state.parameters.at(0)].type];
+    if (state.parameters.size() == 1 && first_parameter_type.kind == C_Type::ENTITY && !first_parameter_type.optional)
+    {
+        // Columns are members of the entity's storage, so they only need to avoid the reserved identities
+        state.storage = C_StateProperty::ENTITY_COLUMN;
+        state.entity = first_parameter_type.index;
+        state.identity = reserved_identities.count(state_property->identity) ? state_property->identity + "_" : state_property->identity;
+    }
+    else
+    {
+        // NOTE: The generator initialises tables with one loop per parameter, each with a reserved counter.
+        if (state.parameters.size() > 4)
+            throw CompilerError("Cannot convert state property '" + state_property->identity + "' with more than 4 parameters - Not yet implemented.", state_property->span);
+
+        string identity;
+        for (auto parameter : state.parameters)
+        {
+            auto &type = ir.types[ir.variables[parameter].type];
+            if (type.kind == C_Type::ENTITY)
+                identity += ir.entities[type.index].name + "_";
+            else if (type.kind == C_Type::ENUM)
+                identity += ir.enums[type.index].identity + "_";
+            else if (type.kind == C_Type::BOOL)
+                identity += "bool_";
+            else
+                throw CompilerError("Cannot convert state property '" + state_property->identity + "', as only entities, enums and bools can be used as the parameters of state.", state_property->span);
+        }
+
+        state.storage = C_StateProperty::TABLE;
+        state.entity = C_NO_INDEX;
+        state.identity = create_identity(identity + state_property->identity);
+    }
+
+    // NOTE: Hidden values are sampled by dealing them out again between the entities that own them,
+    //       so only state with a single entity parameter can be hidden.
+    state.hidden = state_property->hidden;
+    if (state.hidden && state.storage != C_StateProperty::ENTITY_COLUMN)
+        throw CompilerError("Cannot convert hidden state property '" + state_property->identity + "' without a single entity parameter - Not yet implemented.", state_property->span);
+
+    // Initial value
+    if (state_property == Intrinsic::state_player_number)
+    {
+        // Players are created in order, so a player's number is its id
+        state.initial_value = create_expression(C_Expression::VARIABLE, state.type);
+        ir.expressions[state.initial_value].variable = state.parameters[0];
+    }
+    else if (state_property == Intrinsic::state_game_players)
+    {
+        vector<size_t> players;
+        C_Type player_type;
+        player_type.kind = C_Type::ENTITY;
+        player_type.index = ir.intrinsics.player_entity;
+        for (size_t i = 0; i < ir.intrinsics.player_count; i++)
+            players.push_back(create_expression(C_Expression::ENTITY_CREATE, create_type(player_type)));
+
+        state.initial_value = create_expression(C_Expression::LIST_LITERAL, state.type, 0, players);
+    }
+    else if (state_property->initial_value.has_value())
+    {
+        state.initial_value = convert_expression(state_property->initial_value.value(), state.type);
+    }
+    else
+    {
+        state.initial_value = convert_default_value(state.type, false);
+    }
+
+    state_property_indices[state_property] = ir.state_properties.size();
+    ir.state_properties.push_back(state);
+}
+
+// NOTE: An entity is created whenever a variable of an entity type is declared without a value,
+//       or when a fixed size list of entities is created. The capacity of an entity type is the
+//       number of entities that can be created while the game is played, if it can be determined.
+//       Entities created in a for loop are counted once for each element of a list with a fixed
+//       size. Other loops, and procedures and functions other than main, can run any number of times.
+void Converter::determine_entity_capacities()
+{
+    // `nullopt` represents an unknown number of entities
+    vector<optional<size_t>> created(ir.entities.size(), 0);
+
+    for (const auto &entry : program->global_scope->lookup)
+    {
+        auto value = entry.second;
+        vector<Scope::LookupValue> values = {value};
+        if (IS_PTR(value, Scope::OverloadedIdentity))
+            values = AS_PTR(value, Scope::OverloadedIdentity)->overloads;
+
+        for (auto value : values)
+        {
+            // Only the main procedure is known to run exactly once
+            if (IS_PTR(value, Procedure) && AS_PTR(value, Procedure) != Intrinsic::procedure_shuffle)
+            {
+                auto procedure = AS_PTR(value, Procedure);
+                bool is_main = procedure_indices.at(procedure) == ir.intrinsics.main_function;
+                count_entities_created(procedure->body, is_main ? optional<size_t>(1) : nullopt, created);
+            }
+            else if (IS_PTR(value, FunctionProperty))
+            {
+                auto function_property = AS_PTR(value, FunctionProperty);
+                if (function_property->body.has_value())
+                    count_entities_created(function_property->body.value(), nullopt, created);
+            }
+        }
+    }
+
+    if (ir.intrinsics.game_entity != C_NO_INDEX)
+        created[ir.intrinsics.game_entity] = 1;
+
+    // Entities created in the state of other entities. Tables are initialised for every
+    // combination of parameters, so the number of entities they create is not counted.
+    vector<optional<size_t>> capacities = created;
+    for (size_t pass = 0; pass <= ir.entities.size(); pass++)
+    {
+        vector<optional<size_t>> next = created;
+        for (const auto &state : ir.state_properties)
+        {
+            auto &type = ir.types[state.type];
+            if (type.kind != C_Type::LIST || ir.types[type.index].kind != C_Type::ENTITY)
+                continue;
+
+            size_t element_entity = ir.types[type.index].index;
+            size_t per_owner = (type.fixed_size > 0) ? type.fixed_size : ir.intrinsics.player_count;
+            bool is_game_players = state.entity == ir.intrinsics.game_entity && element_entity == ir.intrinsics.player_entity;
+            if (type.fixed_size == 0 && !is_game_players)
+                continue;
+
+            if (state.storage != C_StateProperty::ENTITY_COLUMN || !capacities[state.entity].has_value() || !next[element_entity].has_value())
+                next[element_entity] = nullopt;
+            else
+                next[element_entity] = next[element_entity].value() + per_owner * capacities[state.entity].value();
+        }
+
+        bool changed = next != capacities;
+        capacities = next;
+        if (!changed)
+            break;
+
+        // Entities that contain themselves can be created without limit
+        if (pass == ir.entities.size())
+            for (auto &capacity : capacities)
+                capacity = nullopt;
+    }
+
+    // Entity types with a default capacity can stop the game, which the author is told about
+    for (size_t i = 0; i < ir.entities.size(); i++)
+    {
+        ir.entities[i].capacity = capacities[i].value_or(default_entity_capacity);
+        ir.entities[i].capacity_determined = capacities[i].has_value();
+        if (!capacities[i].has_value())
+            notes.push_back("The number of " + ir.entities[i].name + " entities the game creates could not be determined, so it can create at most " +
+                            to_string(default_entity_capacity) + " of them. Use --entity-capacity to allow more.");
+    }
+}
+
+// NOTE: A dense table has an entry for every combination of its parameters, which grows with the
+//       product of the entity capacities. Large tables are stored sparsely instead, when their
+//       initial value is a constant that the missing entries can take. A sparse table starts with
+//       room for about two entries for each of the values of its parameters, at half load, and
+//       moves to a larger region of the arena as more entries are set.
+void Converter::choose_table_storage()
+{
+    for (auto &state : ir.state_properties)
+    {
+        if (state.storage != C_StateProperty::TABLE || ir.types[state.type].kind == C_Type::LIST)
+            continue;
+
+        auto kind = ir.expressions[state.initial_value].kind;
+        bool is_constant = kind == C_Expression::DOUBLE_LITERAL ||
+                           kind == C_Expression::INT_LITERAL ||
+                           kind == C_Expression::BOOL_LITERAL ||
+                           kind == C_Expression::STRING_LITERAL ||
+                           kind == C_Expression::ENUM_LITERAL ||
+                           kind == C_Expression::NONE_LITERAL;
+        if (!is_constant)
+            continue;
+
+        size_t length = 1;
+        size_t dimensions = 0;
+        for (auto parameter : state.parameters)
+        {
+            auto &type = ir.types[ir.variables[parameter].type];
+            size_t dimension = type.kind == C_Type::ENTITY ? ir.entities[type.index].capacity + 1
+                               : type.kind == C_Type::ENUM ? ir.enums[type.index].values.size() + 1
+                                                           : 2;
+            length *= dimension;
+            dimensions += dimension;
+        }
+
+        if (length <= dense_table_limit)
+            continue;
+
+        size_t capacity = 16;
+        while (capacity < 4 * dimensions)
+            capacity *= 2;
+
+        if (capacity >= length)
+            continue;
+
+        state.storage = C_StateProperty::SPARSE_TABLE;
+        state.sparse_capacity = capacity;
+    }
+}
+
+// NOTE: All state is kept in a single block that is cloned with `memcpy`, so it must not refer to
+//       any memory outside of the block. Values with a small number of possible values (bools,
+//       enums and entities) are packed into as few bits as they need.
+void Converter::pack_state_properties()
+{
+    for (auto &state : ir.state_properties)
+    {
+        // Lists without a fixed size are kept in the arena of the state block, and are expected to
+        // hold at most one of each entity
+        auto &type = ir.types[state.type];
+        if (type.kind == C_Type::LIST && type.fixed_size == 0)
+        {
+            auto &element_type = ir.types[type.index];
+            state.list_capacity = element_type.kind == C_Type::ENTITY ? ir.entities[element_type.index].capacity : default_list_capacity;
+        }
+
+        if (type.kind == C_Type::LIST)
+            for (size_t inner = type.index; ir.types[inner].kind == C_Type::LIST; inner = ir.types[inner].index)
+                if (ir.types[inner].fixed_size == 0)
+                    throw CompilerError("Cannot convert state property '" + state.identity + "', as lists within lists of state must have a fixed size - Not yet implemented.");
+
+        // Sparse tables store their values unpacked, alongside their keys
+        if (state.storage == C_StateProperty::SPARSE_TABLE)
+            state.packed_bits = 0;
+        else if (type.kind == C_Type::BOOL)
+            state.packed_bits = 1;
+        else if (type.kind == C_Type::ENUM)
+            state.packed_bits = bits_for(ir.enums[type.index].values.size());
+        else if (type.kind == C_Type::ENTITY)
+            state.packed_bits = bits_for(ir.entities[type.index].capacity);
+        else
+            state.packed_bits = 0;
+    }
+}
+
+// The number of bits needed to represent every value from 0 to `max_value`
+size_t Converter::bits_for(size_t max_value)
+{
+    size_t bits = 1;
+    while (bits < 64 && (max_value >> bits) != 0)
+        bits++;
+    return bits;
+}
+
+// `repetitions` is the number of times the code block is run, or `nullopt` if it is not known
+void Converter::count_entities_created(ptr<CodeBlock> code_block, optional<size_t> repetitions, vector<optional<size_t>> &created)
+{
+    auto add = [&](Pattern pattern, size_t count)
+    {
+        if (IS_PTR(pattern, PatternLiteral))
+            pattern = AS_PTR(pattern, PatternLiteral)->pattern;
+        if (!IS_PTR(pattern, EntityType))
+            return;
+
+        auto &entity_count = created[entity_indices.at(AS_PTR(pattern, EntityType))];
+        if (!repetitions.has_value() || !entity_count.has_value())
+            entity_count = nullopt;
+        else
+            entity_count = entity_count.value() + count * repetitions.value();
+    };
+
+    for (auto statement : code_block->statements)
+    {
+        if (IS_PTR(statement, VariableDeclaration))
+        {
+            auto declaration = AS_PTR(statement, VariableDeclaration);
+            if (declaration->value.has_value())
+                continue;
+
+            auto pattern = declaration->variable->pattern;
+            if (IS_PTR(pattern, PatternLiteral))
+                pattern = AS_PTR(pattern, PatternLiteral)->pattern;
+
+            if (IS_PTR(pattern, ListType))
+            {
+                auto list_type = AS_PTR(pattern, ListType);
+                auto fixed_size = evaluate_fixed_size(list_type);
+                if (fixed_size.has_value())
+                    add(list_type->list_of, fixed_size.value());
+            }
+            else
+            {
+                add(pattern, 1);
+            }
+        }
+        else if (IS_PTR(statement, IfStatement))
+        {
+            auto if_statement = AS_PTR(statement, IfStatement);
+            for (auto &rule : if_statement->rules)
+                count_entities_created(rule.code_block, repetitions, created);
+            if (if_statement->else_block.has_value())
+                count_entities_created(if_statement->else_block.value(), repetitions, created);
+        }
+        else if (IS_PTR(statement, ForStatement))
+        {
+            // A list of a fixed size has at most that many elements
+            auto for_statement = AS_PTR(statement, ForStatement);
+            auto range_pattern = determine_expression_pattern(for_statement->range);
+            if (IS_PTR(range_pattern, PatternLiteral))
+                range_pattern = AS_PTR(range_pattern, PatternLiteral)->pattern;
+
+            optional<size_t> iterations;
+            if (IS_PTR(range_pattern, ListType))
+                iterations = evaluate_fixed_size(AS_PTR(range_pattern, ListType));
+
+            optional<size_t> body_repetitions;
+            if (repetitions.has_value() && iterations.has_value())
+                body_repetitions = repetitions.value() * iterations.value();
+            count_entities_created(for_statement->body, body_repetitions, created);
+        }
+        else if (IS_PTR(statement, LoopStatement))
+        {
+            count_entities_created(AS_PTR(statement, LoopStatement)->body, nullopt, created);
+        }
+        else if (IS_PTR(statement, CodeBlock))
+        {
+            count_entities_created(AS_PTR(statement, CodeBlock), repetitions, created);
+        }
+    }
+}
+
+// FUNCTIONS
+
+size_t Converter::convert_variable(ptr<Variable> variable)
+{
+    C_Variable c_variable;
+    c_variable.identity = create_local_identity(variable->identity);
+    c_variable.type = convert_type(variable->pattern);
+
+    variable_indices[variable] = ir.variables.size();
+    ir.variables.push_back(c_variable);
+    return ir.variables.size() - 1;
+}
+
+void Converter::declare_function_property(ptr<FunctionProperty> function_property)
+{
+    local_identities_used.clear();
+
+    C_Function funct;
+    funct.return_type = convert_type(function_property->pattern);
+    for (auto parameter : function_property->parameters)
+        funct.parameters.push_back(convert_variable(parameter));
+
+    // Properties of different entities can share an identity, so the entity is included in the function's identity
+    string identity = function_property->identity;
+    if (funct.parameters.size() > 0)
+    {
+        auto &type = ir.types[ir.variables[funct.parameters[0]].type];
+        if (type.kind == C_Type::ENTITY)
+            identity = ir.entities[type.index].name + "_" + identity;
+    }
+    funct.identity = create_identity(identity);
+    funct.body = C_NO_INDEX;
+
+    // A number for how well a player is doing is the evaluation of the game
+    if (function_property->identity == "evaluation" && funct.parameters.size() == 1)
+    {
+        auto &parameter_type = ir.types[ir.variables[funct.parameters[0]].type];
+        auto return_kind = ir.types[funct.return_type].kind;
+        if (parameter_type.kind == C_Type::ENTITY && parameter_type.index == ir.intrinsics.player_entity && !parameter_type.optional &&
+            (return_kind == C_Type::INT || return_kind == C_Type::DOUBLE) && !ir.types[funct.return_type].optional)
+            ir.intrinsics.evaluation_function = ir.functions.size();
+    }
+
+    function_property_indices[function_property] = ir.functions.size();
+    ir.functions.push_back(funct);
+}
+
+void Converter::declare_procedure(ptr<Procedure> procedure)
+{
+    local_identities_used.clear();
+
+    C_Function funct;
+    funct.identity = create_identity(procedure->identity);
+    funct.return_type = void_type;
+    for (auto parameter : procedure->parameters)
+        funct.parameters.push_back(convert_variable(parameter));
+    funct.body = C_NO_INDEX;
+
+    if (procedure->identity == "main")
+        ir.intrinsics.main_function = ir.functions.size();
+
+    procedure_indices[procedure] = ir.functions.size();
+    ir.functions.push_back(funct);
+}
+
+void Converter::convert_function_property(ptr<FunctionProperty> function_property)
+{
+    TraceScope trace("Converter::convert_function_property", function_property);
+
+    size_t funct = function_property_indices.at(function_property);
+    if (!function_property->body.has_value())
+        throw CompilerError("Cannot convert function property '" + function_property->identity + "' without a body - Not yet implemented.", function_property->span);
+
+    local_identities_used.clear();
+    for (auto parameter : ir.functions[funct].parameters)
+        local_identities_used.insert(ir.variables[parameter].identity);
+    current_return_type = ir.functions[funct].return_type;
+    size_t first_expression = ir.expressions.size();
+
+    // The statement of a singleton body is the value of the function
+    auto body = function_property->body.value();
+    if (body->singleton_block && body->statements.size() == 1 && IS(body->statements[0], Expression))
+    {
+        auto block = create_statement(C_Statement::CODE_BLOCK);
+        auto stmt = create_statement(C_Statement::RETURN_STATEMENT);
+        auto value = convert_expression(AS(body->statements[0], Expression), current_return_type);
+        ir.statements[stmt].expression = value;
+        ir.statements[block].statement_count = ir.statements.size() - (block + 1);
+        ir.functions[funct].body = block;
+
+        // A function whose value is a list with a capacity returns it inline, rather than allocating it
+        C_Type value_type = type_of(value);
+        if (value_type.kind == C_Type::LIST && value_type.capacity > 0)
+        {
+            value_type.capacity = 0;
+            if (value_type == ir.types[current_return_type])
+                ir.functions[funct].return_type = ir.expressions[value].type;
+        }
+    }
+    else
+    {
+        ir.functions[funct].body = convert_statement(body);
+    }
+
+    resolve_reference_variables(first_expression);
+}
+
+void Converter::convert_procedure(ptr<Procedure> procedure)
+{
+    TraceScope trace("Converter::convert_procedure", procedure);
+
+    size_t funct = procedure_indices.at(procedure);
+
+    local_identities_used.clear();
+    for (auto parameter : ir.functions[funct].parameters)
+        local_identities_used.insert(ir.variables[parameter].identity);
+    current_return_type = void_type;
+    size_t first_expression = ir.expressions.size();
+
+    ir.functions[funct].body = convert_statement(procedure->body);
+    resolve_reference_variables(first_expression);
+}
+
+// STATIC LISTS
+
+bool Converter::is_constant_list(ptr<ListValue> list_value)
+{
+    if (list_value->values.size() == 0)
+        return false;
+
+    for (auto value : list_value->values)
+    {
+        if (IS_PTR(value, ExpressionLiteral))
+            value = AS_PTR(value, ExpressionLiteral)->expr;
+
+        if (IS_PTR(value, ListValue))
+        {
+            if (!is_constant_list(AS_PTR(value, ListValue)))
+                return false;
+        }
+        else if (!IS_PTR(value, PrimitiveValue) && !IS_PTR(value, EnumValue))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// NOTE: A constant list is kept inline, as is each list in it, with a capacity of the most elements
+//       of any list at its depth, so that it does not need to be allocated when the program starts.
+void Converter::measure_static_list(size_t expression, size_t depth, vector<size_t> &capacities)
+{
+    if (ir.expressions[expression].kind != C_Expression::LIST_LITERAL)
+        return;
+
+    if (capacities.size() <= depth)
+        capacities.push_back(0);
+    capacities[depth] = std::max(capacities[depth], (size_t)ir.expressions[expression].argument_count);
+
+    for (size_t i = 0; i < ir.expressions[expression].argument_count; i++)
+        measure_static_list(ir.arguments[ir.expressions[expression].first_argument + i], depth + 1, capacities);
+}
+
+size_t Converter::inline_list_type(size_t type, const vector<size_t> &capacities, size_t depth)
+{
+    C_Type list_type = ir.types[type];
+    if (list_type.kind != C_Type::LIST || depth >= capacities.size())
+        return type;
+
+    list_type.index = inline_list_type(list_type.index, capacities, depth + 1);
+    list_type.capacity = capacities[depth];
+    return create_type(list_type);
+}
+
+void Converter::set_list_type(size_t expression, size_t type)
+{
+    if (ir.expressions[expression].kind != C_Expression::LIST_LITERAL)
+        return;
+
+    ir.expressions[expression].type = narrow(type);
+    for (size_t i = 0; i < ir.expressions[expression].argument_count; i++)
+        set_list_type(ir.arguments[ir.expressions[expression].first_argument + i], ir.types[type].index);
+}
+
+// NOTE: A variable can only refer to a list, rather than copy it, when the list is never written
+//       through the variable. Writes are found from the expressions of the function just converted.
+void Converter::resolve_reference_variables(size_t first_expression)
+{
+    unordered_set<size_t> written;
+    for (size_t i = first_expression; i < ir.expressions.size(); i++)
+    {
+        auto &expr = ir.expressions[i];
+        if (expr.kind != C_Expression::ASSIGN && expr.kind != C_Expression::LIST_INSERT && expr.kind != C_Expression::LIST_SHUFFLE)
+            continue;
+
+        size_t target = expr.lhs;
+        while (ir.expressions[target].kind == C_Expression::LIST_INDEX)
+            target = ir.expressions[target].lhs;
+        if (ir.expressions[target].kind == C_Expression::VARIABLE)
+            written.insert(ir.expressions[target].variable);
+    }
+
+    // A variable that refers to a list has the type of that list, which is inline if it is a static list
+    for (const auto &candidate : reference_candidates)
+    {
+        if (written.count(candidate.variable) != 0)
+            continue;
+
+        size_t type = ir.expressions[candidate.expression].type;
+        if (candidate.element)
+            type = ir.types[type].index;
+
+        ir.variables[candidate.variable].is_reference = true;
+        ir.variables[candidate.variable].type = type;
+        for (size_t i = first_expression; i < ir.expressions.size(); i++)
+            if (ir.expressions[i].kind == C_Expression::VARIABLE && ir.expressions[i].variable == candidate.variable)
+                ir.expressions[i].type = narrow(type);
+    }
+    reference_candidates.clear();
+}
+
+// MEMOISATION
+
+// NOTE: A function property is memoised when it only reads state, and each of its parameters has a
+//       small number of possible values. Its result is cached for each combination of arguments,
+//       and the cache is checked against the hash of each state property that the function reads,
+//       either directly or through the functions it calls. Functions that read no state are cheaper
+//       to call again than to check a cache for, and a list on the heap costs as much to copy out of
+//       the cache as to build, so neither is memoised.
+void Converter::memoise_function_properties()
+{
+    struct Analysis
+    {
+        bool pure = true;
+        vector<bool> reads;
+        vector<size_t> calls;
+    };
+
+    vector<Analysis> analyses(ir.functions.size());
+    vector<bool> is_function_property(ir.functions.size(), false);
+    for (const auto &entry : function_property_indices)
+        is_function_property[entry.second] = true;
+
+    for (size_t funct = 0; funct < ir.functions.size(); funct++)
+    {
+        auto &analysis = analyses[funct];
+        analysis.reads.assign(ir.state_properties.size(), false);
+        if (!is_function_property[funct] || ir.functions[funct].body == C_NO_INDEX)
+        {
+            analysis.pure = false;
+            continue;
+        }
+
+        size_t body = ir.functions[funct].body;
+        size_t last = body + ir.statements[body].statement_count;
+        for (size_t i = body + 1; i <= last; i++)
+        {
+            const auto &stmt = ir.statements[i];
+            if (stmt.kind == C_Statement::WINS_STATEMENT || stmt.kind == C_Statement::DRAW_STATEMENT)
+                analysis.pure = false;
+
+            bool has_expression = stmt.kind != C_Statement::CODE_BLOCK &&
+                                  stmt.kind != C_Statement::ELSE_STATEMENT &&
+                                  stmt.kind != C_Statement::WHILE_LOOP &&
+                                  stmt.kind != C_Statement::DRAW_STATEMENT;
+            if (has_expression && stmt.expression != C_NO_INDEX)
+                analyse_expression_effects(stmt.expression, analysis.pure, analysis.reads, analysis.calls);
+        }
+    }
+
+    // Functions read everything that the functions they call read
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (auto &analysis : analyses)
+        {
+            for (auto callee : analysis.calls)
+            {
+                const auto &callee_analysis = analyses[callee];
+                if (analysis.pure && !callee_analysis.pure)
+                {
+                    analysis.pure = false;
+                    changed = true;
+                }
+
+                for (size_t i = 0; i < analysis.reads.size(); i++)
+                {
+                    if (callee_analysis.reads[i] && !analysis.reads[i])
+                    {
+                        analysis.reads[i] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t funct = 0; funct < ir.functions.size(); funct++)
+    {
+        auto &c_function = ir.functions[funct];
+        if (!analyses[funct].pure || c_function.parameters.size() > 4)
+            continue;
+
+        const auto &return_type = ir.types[c_function.return_type];
+        if (return_type.kind == C_Type::LIST && return_type.capacity == 0)
+            continue;
+
+        bool reads_state = find(analyses[funct].reads.begin(), analyses[funct].reads.end(), true) != analyses[funct].reads.end();
+        if (!reads_state)
+            continue;
+
+        size_t cache_size = 1;
+        for (auto parameter : c_function.parameters)
+        {
+            const auto &type = ir.types[ir.variables[parameter].type];
+            if (type.kind == C_Type::ENTITY)
+                cache_size *= ir.entities[type.index].capacity + 1;
+            else if (type.kind == C_Type::ENUM)
+                cache_size *= ir.enums[type.index].values.size() + 1;
+            else if (type.kind == C_Type::BOOL)
+                cache_size *= 2;
+            else
+                cache_size = SIZE_MAX;
+
+            if (cache_size > max_cache_size)
+                break;
+        }
+
+        if (cache_size > max_cache_size)
+            continue;
+
+        c_function.memoised = true;
+        c_function.cache_identity = create_identity(c_function.identity + "_cache");
+        for (size_t i = 0; i < ir.state_properties.size(); i++)
+            if (analyses[funct].reads[i])
+                c_function.reads.push_back(i);
+    }
+}
+
+void Converter::analyse_expression_effects(size_t expression, bool &pure, vector<bool> &reads, vector<size_t> &calls)
+{
+    const auto &expr = ir.expressions[expression];
+    auto analyse = [&](size_t sub_expression)
+    {
+        analyse_expression_effects(sub_expression, pure, reads, calls);
+    };
+    auto analyse_arguments = [&]()
+    {
+        for (size_t i = 0; i < expr.argument_count; i++)
+            analyse(ir.arguments[expr.first_argument + i]);
+    };
+
+    switch (expr.kind)
+    {
+    case C_Expression::UNARY_NOT:
+    case C_Expression::UNARY_NEGATE:
+    case C_Expression::IS_SOME:
+        analyse(expr.lhs);
+        break;
+
+    case C_Expression::BINARY_ADD:
+    case C_Expression::BINARY_SUB:
+    case C_Expression::BINARY_MUL:
+    case C_Expression::BINARY_DIV:
+    case C_Expression::BINARY_EQUAL:
+    case C_Expression::BINARY_NOT_EQUAL:
+    case C_Expression::BINARY_LESS:
+    case C_Expression::BINARY_LESS_EQUAL:
+    case C_Expression::BINARY_GREATER:
+    case C_Expression::BINARY_GREATER_EQUAL:
+    case C_Expression::BINARY_AND:
+    case C_Expression::BINARY_OR:
+    case C_Expression::LIST_INDEX:
+        analyse(expr.lhs);
+        analyse(expr.rhs);
+        break;
+
+    case C_Expression::TABLE_LOOKUP:
+    case C_Expression::LIST_COUNT:
+        analyse(expr.lhs);
+        break;
+
+    case C_Expression::LIST_PIPELINE:
+    {
+        const auto &pipeline = ir.pipelines[expr.target];
+        analyse(pipeline.source);
+        for (const auto &stage : pipeline.stages)
+            analyse(stage.body);
+        break;
+    }
+
+    case C_Expression::ASSIGN:
+    case C_Expression::LIST_INSERT:
+    {
+        // Only writes to local variables are allowed
+        size_t target = expr.lhs;
+        while (ir.expressions[target].kind == C_Expression::LIST_INDEX)
+            target = ir.expressions[target].lhs;
+        if (ir.expressions[target].kind != C_Expression::VARIABLE)
+            pure = false;
+
+        analyse(expr.lhs);
+        analyse(expr.rhs);
+        break;
+    }
+
+    // The game's randomness is not part of the state, so a function that shuffles is never memoised
+    case C_Expression::LIST_SHUFFLE:
+        pure = false;
+        analyse(expr.lhs);
+        break;
 
-    return new_identity;
-}
+    case C_Expression::LIST_LITERAL:
+    case C_Expression::CONDITIONAL:
+        analyse_arguments();
+        break;
 
-void Converter::convert_procedure(ptr<Procedure> procedure)
-{
-    C_Function funct;
-    funct.identity = create_identity(procedure->identity);
-    funct.body = convert_statement(procedure->body);
+    case C_Expression::STATE_ACCESS:
+    case C_Expression::ENTITY_SELECT:
+        reads[expr.target] = true;
+        analyse_arguments();
+        break;
 
-    ir.functions.push_back(funct);
+    case C_Expression::FUNCTION_CALL:
+        calls.push_back(expr.target);
+        analyse_arguments();
+        break;
+
+    // Which entities a scan visits depends on how many have been created, which no state property's hash covers
+    case C_Expression::ENTITY_SCAN:
+        pure = false;
+        calls.push_back(expr.target);
+        analyse_arguments();
+        break;
+
+    case C_Expression::ENTITY_CREATE:
+    case C_Expression::CHOOSE:
+        pure = false;
+        break;
+
+    default:
+        break;
+    }
 }
 
+// STATEMENTS
+
 size_t Converter::create_statement(C_Statement::Kind kind)
 {
-    ir.statements.emplace_back().kind = kind;
+    auto &stmt = ir.statements.emplace_back();
+    stmt.kind = kind;
+    stmt.expression = C_NO_INDEX;
+    stmt.variable = C_NO_INDEX;
     return ir.statements.size() - 1;
 }
 
@@ -68,13 +1196,14 @@ size_t Converter::convert_statement(Statement apm)
                 i == 0
                     ? C_Statement::IF_STATEMENT
                     : C_Statement::ELSE_IF_STATEMENT);
-            STMT.expression = convert_expression(rule.condition);
+            auto condition = convert_condition(rule.condition);
+            STMT.expression = condition;
             convert_statement(rule.code_block);
         }
 
         if (if_statement->else_block.has_value())
         {
-            create_statement(C_Statement::IF_STATEMENT);
+            create_statement(C_Statement::ELSE_STATEMENT);
             convert_statement(if_statement->else_block.value());
         }
 
@@ -85,7 +1214,13 @@ size_t Converter::convert_statement(Statement apm)
     {
         auto for_statement = AS_PTR(apm, ForStatement);
         auto stmt = create_statement(C_Statement::FOR_LOOP);
-        // TODO: Convert the range/iterator of the loop
+        auto range = convert_expression(for_statement->range);
+        STMT.expression = range;
+        STMT.variable = convert_variable(for_statement->variable);
+
+        // The elements of a list of lists can be referred to, rather than copied
+        if (ir.types[ir.variables[STMT.variable].type].kind == C_Type::LIST && type_of(range).kind == C_Type::LIST)
+            reference_candidates.push_back({STMT.variable, range, true});
         convert_statement(for_statement->body);
         return statement_index;
     }
@@ -93,7 +1228,7 @@ size_t Converter::convert_statement(Statement apm)
     if (IS_PTR(apm, LoopStatement))
     {
         auto loop_statement = AS_PTR(apm, LoopStatement);
-        auto stmt = create_statement(C_Statement::WHILE_LOOP);
+        create_statement(C_Statement::WHILE_LOOP);
         convert_statement(loop_statement->body);
         return statement_index;
     }
@@ -102,23 +1237,23 @@ size_t Converter::convert_statement(Statement apm)
     {
         auto return_statement = AS_PTR(apm, ReturnStatement);
         auto stmt = create_statement(C_Statement::RETURN_STATEMENT);
-        STMT.expression = convert_expression(return_statement->value);
+        auto value = convert_expression(return_statement->value, current_return_type);
+        STMT.expression = value;
         return statement_index;
     }
 
     if (IS_PTR(apm, WinsStatement))
     {
         auto wins_statement = AS_PTR(apm, WinsStatement);
-        auto stmt = create_statement(C_Statement::EXPRESSION_STATEMENT);
-        // TODO: Implement
+        auto stmt = create_statement(C_Statement::WINS_STATEMENT);
+        auto player = convert_expression(wins_statement->player);
+        STMT.expression = player;
         return statement_index;
     }
 
     if (IS_PTR(apm, DrawStatement))
     {
-        auto draw_statement = AS_PTR(apm, DrawStatement);
-        auto stmt = create_statement(C_Statement::EXPRESSION_STATEMENT);
-        // TODO: Implement
+        create_statement(C_Statement::DRAW_STATEMENT);
         return statement_index;
     }
 
@@ -126,7 +1261,9 @@ size_t Converter::convert_statement(Statement apm)
     {
         auto assignment_statement = AS_PTR(apm, AssignmentStatement);
         auto stmt = create_statement(C_Statement::EXPRESSION_STATEMENT);
-        // TODO: Implement
+        auto subject = convert_expression(assignment_statement->subject);
+        auto value = convert_expression(assignment_statement->value, ir.expressions[subject].type);
+        STMT.expression = create_expression(C_Expression::ASSIGN, void_type, subject, value);
         return statement_index;
     }
 
@@ -134,7 +1271,36 @@ size_t Converter::convert_statement(Statement apm)
     {
         auto variable_declaration = AS_PTR(apm, VariableDeclaration);
         auto stmt = create_statement(C_Statement::VARIABLE_DECLARATION);
-        // TODO: Implement
+
+        // The value is converted first, as it cannot refer to the variable being declared
+        auto type = convert_type(variable_declaration->variable->pattern);
+        auto value = variable_declaration->value.has_value()
+                         ? convert_expression(variable_declaration->value.value(), type)
+                         : convert_default_value(type, true);
+
+        STMT.expression = value;
+        STMT.variable = convert_variable(variable_declaration->variable);
+
+        // A list with a size that is given a value kept inline, such as the values of `choose[k]`, keeps it inline
+        C_Type value_type = type_of(value);
+        if (value_type.kind == C_Type::LIST && value_type.capacity > 0 && value_type.capacity == value_type.fixed_size)
+        {
+            value_type.capacity = 0;
+            if (value_type == ir.types[type])
+                ir.variables[STMT.variable].type = ir.expressions[value].type;
+        }
+
+        // A list built by a pipeline holds values of the variable's element type, and the variable keeps it as it was built
+        if (ir.expressions[value].kind == C_Expression::LIST_PIPELINE && value_type.kind == C_Type::LIST && ir.types[type].kind == C_Type::LIST)
+        {
+            C_Type pipeline_type = type_of(value);
+            pipeline_type.index = ir.types[type].index;
+            ir.expressions[value].type = narrow(create_type(pipeline_type));
+            ir.variables[STMT.variable].type = ir.expressions[value].type;
+        }
+
+        if (ir.expressions[value].kind == C_Expression::STATIC_LIST)
+            reference_candidates.push_back({STMT.variable, value, false});
         return statement_index;
     }
 
@@ -156,7 +1322,8 @@ size_t Converter::convert_statement(Statement apm)
     {
         auto expr = AS(apm, Expression);
         auto stmt = create_statement(C_Statement::EXPRESSION_STATEMENT);
-        STMT.expression = convert_expression(expr);
+        auto expression = convert_expression(expr);
+        STMT.expression = expression;
         return statement_index;
     }
 
@@ -165,7 +1332,139 @@ size_t Converter::convert_statement(Statement apm)
 
 #undef STMT
 
-size_t Converter::convert_expression(Expression apm)
+// EXPRESSIONS
+
+size_t Converter::create_expression(C_Expression::Kind kind, size_t type)
+{
+    return create_expression(kind, type, 0, 0);
+}
+
+size_t Converter::create_expression(C_Expression::Kind kind, size_t type, size_t lhs, size_t rhs)
+{
+    C_Expression expr;
+    expr.kind = kind;
+    expr.type = narrow(type);
+    expr.lhs = lhs;
+    expr.rhs = rhs;
+
+    ir.expressions.emplace_back(expr);
+    return ir.expressions.size() - 1;
+}
+
+size_t Converter::create_expression(C_Expression::Kind kind, size_t type, size_t target, vector<size_t> arguments)
+{
+    C_Expression expr;
+    expr.kind = kind;
+    expr.type = narrow(type);
+    expr.lhs = 0;
+    expr.rhs = 0;
+    expr.target = narrow(target);
+    expr.first_argument = narrow(ir.arguments.size());
+    expr.argument_count = narrow(arguments.size());
+
+    ir.arguments.insert(ir.arguments.end(), arguments.begin(), arguments.end());
+    ir.expressions.emplace_back(expr);
+    return ir.expressions.size() - 1;
+}
+
+// NOTE: Entities are selected through a reverse index of the column, which is only kept for
+//       properties with few enough distinct values to have a bitset of entities for each of them,
+//       as the index is part of the state block. Other properties, and function properties, which
+//       have no column to index, are selected by trying each entity in turn instead.
+size_t Converter::convert_entity_selector(ptr<EntitySelector> entity_selector)
+{
+    if (IS_PTR(entity_selector->property, FunctionProperty))
+    {
+        size_t funct = function_property_indices.at(AS_PTR(entity_selector->property, FunctionProperty));
+
+        C_Type type;
+        type.kind = C_Type::ENTITY;
+        type.optional = true;
+        type.index = ir.types[ir.variables[ir.functions[funct].parameters[0]].type].index;
+
+        auto value = convert_expression(entity_selector->value, ir.functions[funct].return_type);
+        return create_expression(C_Expression::ENTITY_SCAN, create_type(type), funct, vector<size_t>{value});
+    }
+
+    if (!IS_PTR(entity_selector->property, StateProperty))
+        throw CompilerError("Cannot convert EntitySelector, as the property has not been resolved.", entity_selector->span);
+
+    size_t index = state_property_indices.at(AS_PTR(entity_selector->property, StateProperty));
+    auto &state = ir.state_properties[index];
+    const auto &value_type = ir.types[state.type];
+
+    // Other values have too many possible values to index
+    size_t values = SIZE_MAX;
+    if (value_type.kind == C_Type::BOOL)
+        values = 2;
+    else if (value_type.kind == C_Type::ENUM)
+        values = ir.enums[value_type.index].values.size() + 1;
+    else if (value_type.kind == C_Type::ENTITY)
+        values = ir.entities[value_type.index].capacity + 1;
+    else if (value_type.kind == C_Type::LIST)
+        throw CompilerError("Cannot convert an entity selector by the property '" + state.identity + "', as lists cannot be selected by - Not yet implemented.", entity_selector->span);
+
+    if (state.storage != C_StateProperty::ENTITY_COLUMN)
+        throw CompilerError("Cannot convert an entity selector by the property '" + state.identity + "', as it is not stored in a column - Not yet implemented.", entity_selector->span);
+
+    if (state.reverse_index.empty() && values <= max_reverse_index_values)
+    {
+        state.reverse_index = create_identity(state.identity + "_index");
+        state.reverse_index_values = values;
+    }
+
+    C_Type type;
+    type.kind = C_Type::ENTITY;
+    type.optional = true;
+    type.index = state.entity;
+
+    auto value = convert_expression(entity_selector->value, ir.state_properties[index].type);
+    return create_expression(C_Expression::ENTITY_SELECT, create_type(type), index, vector<size_t>{value});
+}
+
+// NOTE: An operation on the result of another list operation adds a stage to its pipeline, rather
+//       than looping over a list of its results.
+size_t Converter::convert_list_operation(ptr<ListOperation> list_operation)
+{
+    auto list = convert_expression(list_operation->list);
+    if (type_of(list).kind != C_Type::LIST)
+        throw CompilerError("Cannot convert a list operation on a value that is not a list.", list_operation->span);
+
+    size_t expression = list;
+    if (ir.expressions[list].kind != C_Expression::LIST_PIPELINE)
+    {
+        C_Pipeline pipeline;
+        pipeline.source = list;
+        ir.pipelines.push_back(pipeline);
+        expression = create_expression(C_Expression::LIST_PIPELINE, ir.expressions[list].type, ir.pipelines.size() - 1, vector<size_t>{});
+    }
+
+    // Each value of the result comes from a different value of the source, so the source bounds its size
+    C_Type type = type_of(expression);
+    size_t source_type = ir.expressions[ir.pipelines[ir.expressions[expression].target].source].type;
+    size_t bound = ir.types[source_type].fixed_size > 0 ? ir.types[source_type].fixed_size : ir.types[source_type].capacity;
+
+    C_Pipeline::Stage stage;
+    stage.is_filter = list_operation->op == "filter";
+    stage.variable = convert_variable(list_operation->variable);
+    stage.body = stage.is_filter ? convert_condition(list_operation->body) : convert_expression(list_operation->body);
+
+    if (!stage.is_filter)
+        type.index = ir.expressions[stage.body].type;
+    type.fixed_size = 0;
+    type.capacity = bound;
+
+    ir.pipelines[ir.expressions[expression].target].stages.push_back(stage);
+    ir.expressions[expression].type = narrow(create_type(type));
+    return expression;
+}
+
+const C_Type &Converter::type_of(size_t expression)
+{
+    return ir.types[ir.expressions[expression].type];
+}
+
+size_t Converter::convert_expression(Expression apm, optional<size_t> type_hint)
 {
     // Literals
     if (IS(apm, UnresolvedLiteral))
@@ -176,147 +1475,391 @@ size_t Converter::convert_expression(Expression apm)
     if (IS_PTR(apm, ExpressionLiteral))
     {
         auto expression_literal = AS_PTR(apm, ExpressionLiteral);
-        return convert_expression(expression_literal->expr);
+        return convert_expression(expression_literal->expr, type_hint);
     }
 
-    C_Expression expr;
-    expr.kind = C_Expression::INVALID;
-
     // Values
     if (IS_PTR(apm, PrimitiveValue))
     {
         auto primitive_value = AS_PTR(apm, PrimitiveValue);
 
+        if (primitive_value == Intrinsic::none_val)
+        {
+            if (!type_hint.has_value() || !ir.types[type_hint.value()].optional)
+                throw CompilerError("Cannot convert `none`, as the type it should be is unknown.");
+            return create_expression(C_Expression::NONE_LITERAL, type_hint.value());
+        }
+
+        auto expr = create_expression(C_Expression::INVALID, convert_type(primitive_value->type));
+        auto &value = ir.expressions[expr];
+
         if (IS(primitive_value->value, double))
         {
-            expr.kind = C_Expression::DOUBLE_LITERAL;
-            expr.double_value = AS(primitive_value->value, double);
+            value.kind = C_Expression::DOUBLE_LITERAL;
+            value.double_value = AS(primitive_value->value, double);
         }
         else if (IS(primitive_value->value, int))
         {
-            expr.kind = C_Expression::INT_LITERAL;
-            expr.int_value = AS(primitive_value->value, int);
+            value.kind = C_Expression::INT_LITERAL;
+            value.int_value = AS(primitive_value->value, int);
         }
         else if (IS(primitive_value->value, bool))
         {
-            expr.kind = C_Expression::BOOL_LITERAL;
-            expr.bool_value = AS(primitive_value->value, bool);
+            value.kind = C_Expression::BOOL_LITERAL;
+            value.bool_value = AS(primitive_value->value, bool);
         }
         else if (IS(primitive_value->value, string))
         {
-            expr.kind = C_Expression::STRING_LITERAL;
-            expr.string_value = AS(primitive_value->value, string);
+            value.kind = C_Expression::STRING_LITERAL;
+            value.string_index = intern_string_literal(AS(primitive_value->value, string));
         }
         else
         {
             throw CompilerError("Could not convert APM PrimitiveValue.");
         }
+
+        return expr;
     }
 
     if (IS_PTR(apm, ListValue))
     {
         auto list_value = AS_PTR(apm, ListValue);
-        // TODO: Implement
+
+        // Constant lists are built once, rather than each time they are evaluated
+        if (!converting_static_list && is_constant_list(list_value))
+        {
+            converting_static_list = true;
+            auto literal = convert_expression(list_value, type_hint);
+            converting_static_list = false;
+
+            vector<size_t> capacities;
+            measure_static_list(literal, 0, capacities);
+            set_list_type(literal, inline_list_type(ir.expressions[literal].type, capacities, 0));
+
+            C_StaticList static_list;
+            static_list.identity = create_identity("gambit_constant");
+            static_list.type = ir.expressions[literal].type;
+            static_list.value = literal;
+
+            auto expr = create_expression(C_Expression::STATIC_LIST, static_list.type);
+            ir.expressions[expr].target = narrow(ir.static_lists.size());
+            ir.static_lists.push_back(static_list);
+            return expr;
+        }
+
+        optional<size_t> element_hint;
+        if (type_hint.has_value() && ir.types[type_hint.value()].kind == C_Type::LIST)
+            element_hint = ir.types[type_hint.value()].index;
+
+        vector<size_t> values;
+        optional<C_Type> element_type;
+        for (auto value : list_value->values)
+        {
+            auto expr = convert_expression(value, element_hint);
+            values.push_back(expr);
+            element_type = element_type.has_value() ? merge_types(element_type.value(), type_of(expr)) : type_of(expr);
+        }
+
+        size_t type;
+        if (element_hint.has_value())
+        {
+            type = type_hint.value();
+        }
+        else if (element_type.has_value())
+        {
+            C_Type list_type;
+            list_type.kind = C_Type::LIST;
+            list_type.index = create_type(element_type.value());
+            list_type.fixed_size = values.size();
+            type = create_type(list_type);
+        }
+        else
+        {
+            throw CompilerError("Cannot convert an empty list, as the type of its elements is unknown.");
+        }
+
+        return create_expression(C_Expression::LIST_LITERAL, type, 0, values);
     }
 
     if (IS_PTR(apm, EnumValue))
     {
         auto enum_value = AS_PTR(apm, EnumValue);
-        // TODO: Implement
+        auto &values = enum_value->type->values;
+
+        auto expr = create_expression(C_Expression::ENUM_LITERAL, convert_type(enum_value));
+        ir.expressions[expr].int_value = (int)(find(values.begin(), values.end(), enum_value) - values.begin()) + 1;
+        return expr;
     }
 
     if (IS_PTR(apm, Variable))
     {
         auto variable = AS_PTR(apm, Variable);
-        // TODO: Implement
+        auto index = variable_indices.find(variable);
+        if (index == variable_indices.end())
+            throw CompilerError("Attempt to convert Variable '" + variable->identity + "' before it has been declared.", variable->span);
+
+        auto expr = create_expression(C_Expression::VARIABLE, ir.variables[index->second].type);
+        ir.expressions[expr].variable = index->second;
+        return expr;
     }
 
     // Operations
     if (IS_PTR(apm, Unary))
     {
         auto unary = AS_PTR(apm, Unary);
-        if (false)
-            ;
-        else
-            throw CompilerError("Could not convert Unary " + unary->op);
 
-        expr.lhs = convert_expression(unary->value);
+        if (unary->op == "not")
+            return create_expression(C_Expression::UNARY_NOT, convert_type(Intrinsic::type_bool), convert_condition(unary->value), 0);
+
+        if (unary->op == "+")
+            return convert_expression(unary->value, type_hint);
+
+        if (unary->op == "-")
+        {
+            auto value = convert_expression(unary->value, type_hint);
+            return create_expression(C_Expression::UNARY_NEGATE, ir.expressions[value].type, value, 0);
+        }
+
+        if (unary->op == "#")
+        {
+            auto list = convert_expression(unary->value);
+            if (type_of(list).kind != C_Type::LIST)
+                throw CompilerError("Cannot convert the count of a value that is not a list.", unary->span);
+
+            // The values that reach the end of a chain of list operations are counted rather than collected
+            auto int_type = convert_type(Intrinsic::type_int);
+            if (ir.expressions[list].kind == C_Expression::LIST_PIPELINE)
+            {
+                ir.pipelines[ir.expressions[list].target].sink = C_Pipeline::COUNT;
+                ir.expressions[list].type = narrow(int_type);
+                return list;
+            }
+
+            return create_expression(C_Expression::LIST_COUNT, int_type, list, 0);
+        }
+
+        throw CompilerError("Could not convert Unary " + unary->op);
     }
 
     if (IS_PTR(apm, Binary))
     {
         auto binary = AS_PTR(apm, Binary);
-        if (binary->op == "+")
-            expr.kind = C_Expression::BINARY_ADD;
-        else if (binary->op == "-")
-            expr.kind = C_Expression::BINARY_SUB;
-        else if (binary->op == "*")
-            expr.kind = C_Expression::BINARY_MUL;
-        else if (binary->op == "/")
-            expr.kind = C_Expression::BINARY_DIV;
-        else if (binary->op == "==")
-            expr.kind = C_Expression::BINARY_EQUAL;
-        else if (binary->op == "and")
-            expr.kind = C_Expression::BINARY_AND;
-        else if (binary->op == "or")
-            expr.kind = C_Expression::BINARY_OR;
+        auto op = binary->op;
+        auto bool_type = convert_type(Intrinsic::type_bool);
+
+        if (op == "and" || op == "or")
+        {
+            auto lhs = convert_condition(binary->lhs);
+            auto rhs = convert_condition(binary->rhs);
+            return create_expression(op == "and" ? C_Expression::BINARY_AND : C_Expression::BINARY_OR, bool_type, lhs, rhs);
+        }
+
+        if (op == "insert")
+        {
+            auto lhs = convert_expression(binary->lhs);
+            if (type_of(lhs).kind != C_Type::LIST)
+                throw CompilerError("Cannot convert `insert` into a value that is not a list.", binary->span);
+
+            auto rhs = convert_expression(binary->rhs, type_of(lhs).index);
+            return create_expression(C_Expression::LIST_INSERT, void_type, lhs, rhs);
+        }
+
+        // `none` takes the type of the value it is compared to
+        auto is_none = [](Expression expr)
+        {
+            if (IS_PTR(expr, ExpressionLiteral))
+                expr = AS_PTR(expr, ExpressionLiteral)->expr;
+            return IS_PTR(expr, PrimitiveValue) && AS_PTR(expr, PrimitiveValue) == Intrinsic::none_val;
+        };
+
+        size_t lhs, rhs;
+        if (is_none(binary->lhs))
+        {
+            rhs = convert_expression(binary->rhs);
+            lhs = convert_expression(binary->lhs, ir.expressions[rhs].type);
+        }
+        else
+        {
+            lhs = convert_expression(binary->lhs);
+            rhs = convert_expression(binary->rhs, ir.expressions[lhs].type);
+        }
+
+        C_Expression::Kind kind;
+        if (op == "==")
+            kind = C_Expression::BINARY_EQUAL;
+        else if (op == "!=")
+            kind = C_Expression::BINARY_NOT_EQUAL;
+        else if (op == "<")
+            kind = C_Expression::BINARY_LESS;
+        else if (op == "<=")
+            kind = C_Expression::BINARY_LESS_EQUAL;
+        else if (op == ">")
+            kind = C_Expression::BINARY_GREATER;
+        else if (op == ">=")
+            kind = C_Expression::BINARY_GREATER_EQUAL;
+        else if (op == "+")
+            kind = C_Expression::BINARY_ADD;
+        else if (op == "-")
+            kind = C_Expression::BINARY_SUB;
+        else if (op == "*")
+            kind = C_Expression::BINARY_MUL;
+        else if (op == "/")
+            kind = C_Expression::BINARY_DIV;
         else
-            throw CompilerError("Could not convert Binary " + binary->op);
+            throw CompilerError("Could not convert Binary " + op);
+
+        if (kind >= C_Expression::BINARY_EQUAL)
+            return create_expression(kind, bool_type, lhs, rhs);
 
-        expr.lhs = convert_expression(binary->lhs);
-        expr.rhs = convert_expression(binary->rhs);
+        // Arithmetic is done with integers where possible, however division always results in a `num`
+        bool is_int = type_of(lhs).kind == C_Type::INT && type_of(rhs).kind == C_Type::INT && kind != C_Expression::BINARY_DIV;
+        auto type = convert_type(is_int ? Intrinsic::type_int : Intrinsic::type_num);
+        return create_expression(kind, type, lhs, rhs);
     }
 
     // Indexing
     if (IS_PTR(apm, InstanceList))
     {
+        // An InstanceList with a single value is a parenthesised expression
         auto instance_list = AS_PTR(apm, InstanceList);
-        // TODO: Implement
+        if (instance_list->values.size() != 1)
+            throw CompilerError("Cannot convert an InstanceList outside of a property access.", instance_list->span);
+
+        return convert_expression(instance_list->values[0], type_hint);
     }
 
     if (IS_PTR(apm, IndexWithExpression))
     {
         auto index_with_expression = AS_PTR(apm, IndexWithExpression);
-        // TODO: Implement
+        auto subject = convert_expression(index_with_expression->subject);
+        if (type_of(subject).kind != C_Type::LIST)
+            throw CompilerError("Cannot convert an index into a value that is not a list.", index_with_expression->span);
+
+        auto index = convert_expression(index_with_expression->index);
+        return create_expression(C_Expression::LIST_INDEX, type_of(subject).index, subject, index);
     }
 
     if (IS_PTR(apm, IndexWithIdentity))
     {
-        auto index_with_identity = AS_PTR(apm, IndexWithIdentity);
-        // TODO: Implement
+        throw CompilerError("Attempt to convert APM IndexWithIdentity", AS_PTR(apm, IndexWithIdentity)->span);
+    }
+
+    if (IS_PTR(apm, EntitySelector))
+    {
+        return convert_entity_selector(AS_PTR(apm, EntitySelector));
+    }
+
+    // List operations
+    if (IS_PTR(apm, ListOperation))
+    {
+        return convert_list_operation(AS_PTR(apm, ListOperation));
     }
 
     // Calls
     if (IS_PTR(apm, Call))
     {
         auto call = AS_PTR(apm, Call);
-        // TODO: Implement
+        if (call->procedure == Intrinsic::procedure_shuffle)
+        {
+            auto list = convert_expression(call->arguments.at(0).value);
+            if (type_of(list).kind != C_Type::LIST)
+                throw CompilerError("Cannot convert `shuffle` of a value that is not a list.", call->span);
+            return create_expression(C_Expression::LIST_SHUFFLE, void_type, list, C_NO_INDEX);
+        }
+
+        throw CompilerError("Cannot convert Call - Not yet implemented.", call->span);
     }
 
     if (IS_PTR(apm, PropertyAccess))
     {
-        auto property_access = AS_PTR(apm, PropertyAccess);
-        // TODO: Implement
+        return convert_property_access(AS_PTR(apm, PropertyAccess));
     }
 
     // Keyword expressions
     if (IS_PTR(apm, ChooseExpression))
     {
         auto choose_expression = AS_PTR(apm, ChooseExpression);
-        // TODO: Implement
+        auto player = convert_expression(choose_expression->player);
+        auto prompt = convert_expression(choose_expression->prompt);
+        auto choices = convert_expression(choose_expression->choices);
+        if (type_of(choices).kind != C_Type::LIST)
+            throw CompilerError("Cannot convert a choice between values that are not a list - Not yet implemented.", choose_expression->span);
+
+        if (!choose_expression->count.has_value())
+            return create_expression(C_Expression::CHOOSE, type_of(choices).index, 0, {player, prompt, choices});
+
+        // The values chosen by `choose[k]` are returned inline, so the number of them must be known
+        auto list_type = CREATE(ListType);
+        list_type->fixed_size = choose_expression->count;
+        auto count = evaluate_fixed_size(list_type);
+        if (!count.has_value() || count.value() == 0)
+            throw CompilerError("Cannot convert `choose` of a number of values that is not a positive literal - Not yet implemented.", choose_expression->span);
+
+        C_Type chosen_type;
+        chosen_type.kind = C_Type::LIST;
+        chosen_type.index = type_of(choices).index;
+        chosen_type.fixed_size = count.value();
+        chosen_type.capacity = count.value();
+        return create_expression(C_Expression::CHOOSE, create_type(chosen_type), 0, {player, prompt, choices});
     }
 
     // "Statement style" expressions
-    if (IS_PTR(apm, IfExpression))
+    // NOTE: These are converted into a chain of conditional expressions, ending with the
+    //       else rule if there is one.
+    if (IS_PTR(apm, IfExpression) || IS_PTR(apm, MatchExpression))
     {
-        auto if_expression = AS_PTR(apm, IfExpression);
-        // TODO: Implement
-    }
+        vector<size_t> conditions;
+        vector<size_t> results;
+        bool has_else;
+        ptr<MatchExpression> match = nullptr;
+        size_t subject = 0;
 
-    if (IS_PTR(apm, MatchExpression))
-    {
-        auto match_expression = AS_PTR(apm, MatchExpression);
-        // TODO: Implement
+        if (IS_PTR(apm, IfExpression))
+        {
+            auto if_expression = AS_PTR(apm, IfExpression);
+            has_else = if_expression->has_else;
+            for (auto &rule : if_expression->rules)
+            {
+                conditions.push_back(convert_condition(rule.condition));
+                results.push_back(convert_expression(rule.result, type_hint));
+            }
+        }
+        else
+        {
+            match = AS_PTR(apm, MatchExpression);
+            has_else = match->has_else;
+            subject = convert_expression(match->subject);
+            for (auto &rule : match->rules)
+                results.push_back(convert_expression(rule.result, type_hint));
+        }
+
+        if (results.size() == 0)
+            throw CompilerError("Cannot convert an if or match expression without any rules.", get_span(apm));
+
+        size_t type = type_hint.value_or(ir.expressions[results[0]].type);
+        if (!type_hint.has_value())
+        {
+            C_Type merged = type_of(results[0]);
+            for (auto result : results)
+                merged = merge_types(merged, type_of(result));
+            type = create_type(merged);
+        }
+
+        if (match != nullptr)
+        {
+            auto table = convert_match_table(subject, match, results, type);
+            if (table.has_value())
+                return table.value();
+
+            for (auto &rule : match->rules)
+                conditions.push_back(convert_pattern_test(subject, rule.pattern));
+        }
+
+        size_t expr = has_else ? results.back() : create_expression(C_Expression::NO_MATCH, type);
+        for (size_t i = results.size() - (has_else ? 1 : 0); i-- > 0;)
+            expr = create_expression(C_Expression::CONDITIONAL, type, 0, {conditions[i], results[i], expr});
+
+        return expr;
     }
 
     // Invalid expression
@@ -325,11 +1868,265 @@ size_t Converter::convert_expression(Expression apm)
         throw CompilerError("Attempt to convert APM InvalidExpression");
     }
 
-    // TODO: Should error here!
-    // if (e.kind == INVALID)
-    //     throw CompilerError("Could not convert APM Expression, variant not recognised.");
+    throw CompilerError("Could not convert APM Expression, variant not recognised.");
+}
+
+// Converts an expression that is used as a condition. Optional values are true when they are not `none`.
+size_t Converter::convert_condition(Expression expression)
+{
+    auto expr = convert_expression(expression);
+    if (!type_of(expr).optional)
+        return expr;
 
-    auto expression_index = ir.expressions.size();
-    ir.expressions.emplace_back(expr);
-    return expression_index;
-}
\ No newline at end of file
+    return create_expression(C_Expression::IS_SOME, convert_type(Intrinsic::type_bool), expr, 0);
+}
+
+size_t Converter::convert_pattern_test(size_t subject, Pattern pattern)
+{
+    auto bool_type = convert_type(Intrinsic::type_bool);
+
+    if (IS_PTR(pattern, PatternLiteral))
+        return convert_pattern_test(subject, AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, PrimitiveValue) && AS_PTR(pattern, PrimitiveValue) == Intrinsic::none_val)
+    {
+        auto is_some = create_expression(C_Expression::IS_SOME, bool_type, subject, 0);
+        return create_expression(C_Expression::UNARY_NOT, bool_type, is_some, 0);
+    }
+
+    if (IS_PTR(pattern, PrimitiveValue))
+        return create_expression(C_Expression::BINARY_EQUAL, bool_type, subject, convert_expression(AS_PTR(pattern, PrimitiveValue), ir.expressions[subject].type));
+
+    if (IS_PTR(pattern, EnumValue))
+        return create_expression(C_Expression::BINARY_EQUAL, bool_type, subject, convert_expression(AS_PTR(pattern, EnumValue)));
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        auto union_pattern = AS_PTR(pattern, UnionPattern);
+        optional<size_t> test;
+        for (auto sub_pattern : union_pattern->patterns)
+        {
+            auto sub_test = convert_pattern_test(subject, sub_pattern);
+            test = test.has_value() ? create_expression(C_Expression::BINARY_OR, bool_type, test.value(), sub_test) : sub_test;
+        }
+        if (test.has_value())
+            return test.value();
+    }
+
+    // FIXME: Type patterns always match, as the checker has already ensured the subject is of the right type.
+    //        This will no longer be true once values can be of a union of types.
+    if (IS_PTR(pattern, AnyPattern) ||
+        IS_PTR(pattern, PrimitiveType) ||
+        IS_PTR(pattern, ListType) ||
+        IS_PTR(pattern, EnumType) ||
+        IS_PTR(pattern, EntityType))
+    {
+        auto expr = create_expression(C_Expression::BOOL_LITERAL, bool_type);
+        ir.expressions[expr].bool_value = true;
+        return expr;
+    }
+
+    throw CompilerError("Cannot convert Pattern variant to a test of a value.");
+}
+
+// NOTE: A match of an enum value, where the result of each rule is a literal, is converted to a
+//       lookup table with the result for each value of the enum, rather than a chain of tests.
+optional<size_t> Converter::convert_match_table(size_t subject, ptr<MatchExpression> match, const vector<size_t> &results, size_t type)
+{
+    const auto &subject_type = type_of(subject);
+    if (subject_type.kind != C_Type::ENUM)
+        return {};
+
+    for (auto result : results)
+    {
+        auto kind = ir.expressions[result].kind;
+        bool is_literal = kind == C_Expression::DOUBLE_LITERAL ||
+                          kind == C_Expression::INT_LITERAL ||
+                          kind == C_Expression::BOOL_LITERAL ||
+                          kind == C_Expression::STRING_LITERAL ||
+                          kind == C_Expression::ENUM_LITERAL ||
+                          kind == C_Expression::NONE_LITERAL;
+        if (!is_literal || !(type_of(result) == ir.types[type]))
+            return {};
+    }
+
+    // The result of each value is the result of the first rule that matches it
+    size_t value_count = ir.enums[subject_type.index].values.size() + 1;
+    vector<size_t> slots(value_count, C_NO_INDEX);
+    for (size_t i = 0; i < match->rules.size(); i++)
+    {
+        vector<bool> matched(value_count, false);
+        if (match->has_else && i == match->rules.size() - 1)
+            matched.assign(value_count, true);
+        else if (!collect_matched_enum_values(match->rules[i].pattern, matched))
+            return {};
+
+        for (size_t value = 0; value < value_count; value++)
+            if (matched[value] && slots[value] == C_NO_INDEX)
+                slots[value] = results[i];
+    }
+
+    // A subject that cannot be `none` never reads the first entry of the table
+    if (slots[0] == C_NO_INDEX && !subject_type.optional)
+        slots[0] = convert_default_value(type, false);
+
+    // Values without a result have to fail at runtime
+    for (auto slot : slots)
+        if (slot == C_NO_INDEX)
+            return {};
+
+    C_Type table_type;
+    table_type.kind = C_Type::LIST;
+    table_type.index = type;
+    table_type.fixed_size = value_count;
+
+    C_StaticList table;
+    table.identity = create_identity("gambit_constant");
+    table.type = create_type(table_type);
+    table.value = create_expression(C_Expression::LIST_LITERAL, table.type, 0, slots);
+    table.is_lookup_table = true;
+
+    auto expr = create_expression(C_Expression::TABLE_LOOKUP, type, subject, ir.static_lists.size());
+    ir.static_lists.push_back(table);
+    return expr;
+}
+
+// Marks the values of an enum (with `none` at index 0) that a pattern matches. Returns false if
+// the pattern cannot be resolved to a set of values.
+bool Converter::collect_matched_enum_values(Pattern pattern, vector<bool> &matched)
+{
+    if (IS_PTR(pattern, PatternLiteral))
+        return collect_matched_enum_values(AS_PTR(pattern, PatternLiteral)->pattern, matched);
+
+    if (IS_PTR(pattern, PrimitiveValue) && AS_PTR(pattern, PrimitiveValue) == Intrinsic::none_val)
+    {
+        matched[0] = true;
+        return true;
+    }
+
+    if (IS_PTR(pattern, EnumValue))
+    {
+        auto enum_value = AS_PTR(pattern, EnumValue);
+        auto &values = enum_value->type->values;
+        size_t index = (find(values.begin(), values.end(), enum_value) - values.begin()) + 1;
+        if (index >= matched.size())
+            return false;
+
+        matched[index] = true;
+        return true;
+    }
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        for (auto sub_pattern : AS_PTR(pattern, UnionPattern)->patterns)
+            if (!collect_matched_enum_values(sub_pattern, matched))
+                return false;
+        return true;
+    }
+
+    // Matches anything, as with `convert_pattern_test`
+    if (IS_PTR(pattern, AnyPattern) || IS_PTR(pattern, EnumType))
+    {
+        matched.assign(matched.size(), true);
+        return true;
+    }
+
+    return false;
+}
+
+// NOTE: A declared entity without a value creates a new entity, as does a fixed size list of entities.
+size_t Converter::convert_default_value(size_t type, bool create_entities)
+{
+    auto c_type = ir.types[type];
+    if (c_type.optional)
+        return create_expression(C_Expression::NONE_LITERAL, type);
+
+    switch (c_type.kind)
+    {
+    case C_Type::BOOL:
+    case C_Type::INT:
+    case C_Type::DOUBLE:
+    case C_Type::STRING:
+    {
+        // Primitive values are value initialised by the generator
+        return create_expression(C_Expression::NONE_LITERAL, type);
+    }
+
+    case C_Type::ENUM:
+    {
+        if (ir.enums[c_type.index].values.size() == 0)
+            throw CompilerError("Cannot create a default value for enum '" + ir.enums[c_type.index].identity + "' as it has no values.");
+
+        auto expr = create_expression(C_Expression::ENUM_LITERAL, type);
+        ir.expressions[expr].int_value = 1;
+        return expr;
+    }
+
+    case C_Type::ENTITY:
+    {
+        return create_expression(create_entities ? C_Expression::ENTITY_CREATE : C_Expression::NONE_LITERAL, type);
+    }
+
+    case C_Type::LIST:
+    {
+        auto &element_type = ir.types[c_type.index];
+        vector<size_t> elements;
+        if (element_type.kind == C_Type::ENTITY && !element_type.optional)
+        {
+            for (size_t i = 0; i < c_type.fixed_size; i++)
+                elements.push_back(create_expression(C_Expression::ENTITY_CREATE, c_type.index));
+        }
+
+        return create_expression(C_Expression::LIST_LITERAL, type, 0, elements);
+    }
+
+    default:
+        throw CompilerError("Cannot create a default value of C_Type " + to_string(c_type.kind));
+    }
+}
+
+size_t Converter::convert_property_access(ptr<PropertyAccess> property_access)
+{
+    vector<Expression> values;
+    if (IS_PTR(property_access->subject, InstanceList))
+        values = AS_PTR(property_access->subject, InstanceList)->values;
+    else
+        values.push_back(property_access->subject);
+
+    auto property = property_access->property;
+    C_Expression::Kind kind;
+    size_t target, type;
+    vector<size_t> parameters;
+
+    if (IS_PTR(property, StateProperty))
+    {
+        kind = C_Expression::STATE_ACCESS;
+        target = state_property_indices.at(AS_PTR(property, StateProperty));
+        type = ir.state_properties[target].type;
+        parameters = ir.state_properties[target].parameters;
+    }
+    else if (IS_PTR(property, FunctionProperty))
+    {
+        kind = C_Expression::FUNCTION_CALL;
+        target = function_property_indices.at(AS_PTR(property, FunctionProperty));
+        type = ir.functions[target].return_type;
+        parameters = ir.functions[target].parameters;
+    }
+    else
+    {
+        throw CompilerError("Cannot convert PropertyAccess, as the property has not been resolved.", property_access->span);
+    }
+
+    // Parameters without a corresponding value are optional, and so are `none`
+    vector<size_t> arguments;
+    for (size_t i = 0; i < parameters.size(); i++)
+    {
+        auto parameter_type = ir.variables[parameters[i]].type;
+        if (i < values.size())
+            arguments.push_back(convert_expression(values[i], parameter_type));
+        else
+            arguments.push_back(create_expression(C_Expression::NONE_LITERAL, parameter_type));
+    }
+
+    return create_expression(kind, type, target, arguments);
+}
@@ -2,6 +2,7 @@
 #ifndef CONVERTER_H
 #define CONVERTER_H
 
+#include <unordered_map>
 #include <unordered_set>
 #include "apm.h"
 #include "ir.h"
@@ -10,20 +11,109 @@ using namespace std;
 class Converter
 {
 public:
+    // NOTE: The IR is moved out of the converter, so `convert` should only be called once per Converter.
     C_Program convert(ptr<Program> program);
 
+    // The number of entities that can be created when the capacity of an entity type can't be determined
+    size_t default_entity_capacity = 64;
+
+    // Limits of the converted program that the author should know about, such as the capacities above
+    vector<string> notes;
+
 private:
     ptr<Program> program = nullptr;
     C_Program ir;
 
+    // The number of elements a list of state without a fixed size is expected to hold, when they aren't entities
+    static constexpr size_t default_list_capacity = 16;
+
+    // Tables with more entries than this are stored sparsely, when they can be
+    static constexpr size_t dense_table_limit = 4096;
+
+    // Properties with more possible values than this are selected by without a reverse index, which
+    // has a bitset of every entity for each value
+    static constexpr size_t max_reverse_index_values = 64;
+
+    unordered_map<ptr<EnumType>, size_t> enum_indices;
+    unordered_map<ptr<EntityType>, size_t> entity_indices;
+    unordered_map<ptr<StateProperty>, size_t> state_property_indices;
+    unordered_map<ptr<FunctionProperty>, size_t> function_property_indices;
+    unordered_map<ptr<Procedure>, size_t> procedure_indices;
+    unordered_map<ptr<Variable>, size_t> variable_indices;
+
+    // Identities
     unordered_set<string> identities_used;
+    unordered_set<string> local_identities_used;
     string create_identity(string identity);
+    string create_local_identity(string identity);
+
+    unordered_map<string, size_t> string_literal_indices;
+    size_t intern_string_literal(string value);
 
+    // Types and storage
+    size_t create_type(C_Type type);
+    size_t convert_type(Pattern pattern);
+    C_Type merge_types(C_Type a, C_Type b);
+    optional<size_t> evaluate_fixed_size(ptr<ListType> list_type);
+
+    void convert_enum(ptr<EnumType> enum_type);
+    void convert_entity(ptr<EntityType> entity_type);
+    void convert_state_property(ptr<StateProperty> state_property);
+    void determine_entity_capacities();
+    void choose_table_storage();
+    void pack_state_properties();
+    size_t bits_for(size_t max_value);
+    void count_entities_created(ptr<CodeBlock> code_block, optional<size_t> repetitions, vector<optional<size_t>> &counts);
+
+    // Functions
+    size_t convert_variable(ptr<Variable> variable);
+    void declare_function_property(ptr<FunctionProperty> function_property);
+    void declare_procedure(ptr<Procedure> procedure);
+    void convert_function_property(ptr<FunctionProperty> function_property);
     void convert_procedure(ptr<Procedure> procedure);
 
+    size_t void_type;
+    size_t current_return_type;
+
+    // Static lists
+    bool converting_static_list = false;
+    struct ReferenceCandidate
+    {
+        size_t variable;   // C_Variable that may refer to a list, rather than copy it
+        size_t expression; // C_Expression of the list it refers to, or of the list of lists whose elements it refers to
+        bool element;
+    };
+    vector<ReferenceCandidate> reference_candidates;
+    bool is_constant_list(ptr<ListValue> list_value);
+    void measure_static_list(size_t expression, size_t depth, vector<size_t> &capacities);
+    size_t inline_list_type(size_t type, const vector<size_t> &capacities, size_t depth);
+    void set_list_type(size_t expression, size_t type);
+    void resolve_reference_variables(size_t first_expression);
+
+    // Memoisation
+    static constexpr size_t max_cache_size = 1 << 16;
+    void memoise_function_properties();
+    void analyse_expression_effects(size_t expression, bool &pure, vector<bool> &reads, vector<size_t> &calls);
+
+    // Statements
     size_t create_statement(C_Statement::Kind kind);
     size_t convert_statement(Statement statement);
-    size_t convert_expression(Expression expression);
+
+    // Expressions
+    size_t create_expression(C_Expression::Kind kind, size_t type);
+    size_t create_expression(C_Expression::Kind kind, size_t type, size_t lhs, size_t rhs);
+    size_t create_expression(C_Expression::Kind kind, size_t type, size_t target, vector<size_t> arguments);
+    size_t convert_expression(Expression expression, optional<size_t> type_hint = {});
+    size_t convert_condition(Expression expression);
+    size_t convert_pattern_test(size_t subject, Pattern pattern);
+    optional<size_t> convert_match_table(size_t subject, ptr<MatchExpression> match, const vector<size_t> &results, size_t type);
+    bool collect_matched_enum_values(Pattern pattern, vector<bool> &matched);
+    size_t convert_default_value(size_t type, bool create_entities);
+    size_t convert_property_access(ptr<PropertyAccess> property_access);
+    size_t convert_entity_selector(ptr<EntitySelector> entity_selector);
+    size_t convert_list_operation(ptr<ListOperation> list_operation);
+
+    const C_Type &type_of(size_t expression);
 };
 
-#endif
\ No newline at end of file
+#endif
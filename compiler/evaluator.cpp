@@ -0,0 +1,582 @@
+#include "evaluator.h"
+#include "intrinsic.h"
+#include "trace.h"
+#include <cmath>
+#include <limits>
+
+void Evaluator::evaluate(ptr<Program> program)
+{
+    TraceScope trace("Evaluator::evaluate");
+
+    for (const auto &entry : program->global_scope->lookup)
+    {
+        auto value = entry.second;
+        if (IS_PTR(value, Scope::OverloadedIdentity))
+        {
+            for (auto overload : AS_PTR(value, Scope::OverloadedIdentity)->overloads)
+                evaluate_scope_lookup_value(overload);
+        }
+        else
+        {
+            evaluate_scope_lookup_value(value);
+        }
+    }
+}
+
+// PROGRAM STRUCTURE //
+
+void Evaluator::evaluate_scope_lookup_value(Scope::LookupValue value)
+{
+    if (IS_PTR(value, StateProperty))
+    {
+        auto state = AS_PTR(value, StateProperty);
+        evaluate_pattern(state->pattern);
+        for (auto parameter : state->parameters)
+            evaluate_variable(parameter);
+
+        if (state->initial_value.has_value())
+            state->initial_value = evaluate_expression(state->initial_value.value());
+    }
+
+    else if (IS_PTR(value, FunctionProperty))
+    {
+        auto funct = AS_PTR(value, FunctionProperty);
+        evaluate_pattern(funct->pattern);
+        for (auto parameter : funct->parameters)
+            evaluate_variable(parameter);
+
+        if (funct->body.has_value())
+            evaluate_code_block(funct->body.value());
+    }
+
+    else if (IS_PTR(value, Procedure))
+    {
+        auto procedure = AS_PTR(value, Procedure);
+        for (auto parameter : procedure->parameters)
+            evaluate_variable(parameter);
+
+        evaluate_code_block(procedure->body);
+    }
+}
+
+void Evaluator::evaluate_code_block(ptr<CodeBlock> code_block)
+{
+    for (auto &statement : code_block->statements)
+        evaluate_statement(statement);
+}
+
+// STATEMENTS //
+
+void Evaluator::evaluate_statement(Statement &statement)
+{
+    if (IS_PTR(statement, IfStatement))
+    {
+        auto stmt = AS_PTR(statement, IfStatement);
+        if (stmt->else_block.has_value())
+            evaluate_code_block(stmt->else_block.value());
+
+        // As with `if` expressions, rules that cannot be chosen are removed, and a rule that is
+        // always chosen replaces the statement
+        vector<IfStatement::Rule> rules;
+        for (auto rule : stmt->rules)
+        {
+            rule.condition = evaluate_expression(rule.condition);
+            evaluate_code_block(rule.code_block);
+
+            auto condition = constant_of(rule.condition);
+            bool is_constant = condition.has_value() &&
+                               IS_PTR(condition.value(), PrimitiveValue) &&
+                               IS(AS_PTR(condition.value(), PrimitiveValue)->value, bool);
+
+            if (is_constant && !AS(AS_PTR(condition.value(), PrimitiveValue)->value, bool))
+                continue;
+
+            if (is_constant && rules.size() == 0)
+            {
+                statement = rule.code_block;
+                return;
+            }
+
+            rules.push_back(rule);
+        }
+
+        if (rules.size() > 0)
+            stmt->rules = rules;
+        else if (stmt->else_block.has_value())
+            statement = stmt->else_block.value();
+    }
+
+    else if (IS_PTR(statement, ForStatement))
+    {
+        auto stmt = AS_PTR(statement, ForStatement);
+        evaluate_variable(stmt->variable);
+        stmt->range = evaluate_expression(stmt->range);
+        evaluate_code_block(stmt->body);
+    }
+
+    else if (IS_PTR(statement, LoopStatement))
+    {
+        evaluate_code_block(AS_PTR(statement, LoopStatement)->body);
+    }
+
+    else if (IS_PTR(statement, ReturnStatement))
+    {
+        auto stmt = AS_PTR(statement, ReturnStatement);
+        stmt->value = evaluate_expression(stmt->value);
+    }
+
+    else if (IS_PTR(statement, WinsStatement))
+    {
+        auto stmt = AS_PTR(statement, WinsStatement);
+        stmt->player = evaluate_expression(stmt->player);
+    }
+
+    else if (IS_PTR(statement, AssignmentStatement))
+    {
+        auto stmt = AS_PTR(statement, AssignmentStatement);
+        stmt->subject = evaluate_expression(stmt->subject);
+        stmt->value = evaluate_expression(stmt->value);
+    }
+
+    else if (IS_PTR(statement, VariableDeclaration))
+    {
+        auto stmt = AS_PTR(statement, VariableDeclaration);
+        evaluate_variable(stmt->variable);
+        if (stmt->value.has_value())
+            stmt->value = evaluate_expression(stmt->value.value());
+    }
+
+    else if (IS_PTR(statement, CodeBlock))
+    {
+        evaluate_code_block(AS_PTR(statement, CodeBlock));
+    }
+
+    else if (IS(statement, Expression))
+    {
+        statement = evaluate_expression(AS(statement, Expression));
+    }
+}
+
+// EXPRESSIONS //
+
+Expression Evaluator::evaluate_expression(Expression expression)
+{
+    if (IS_PTR(expression, ExpressionLiteral))
+    {
+        auto literal = AS_PTR(expression, ExpressionLiteral);
+        literal->expr = evaluate_expression(literal->expr);
+        return literal;
+    }
+
+    if (IS_PTR(expression, ListValue))
+    {
+        for (auto &value : AS_PTR(expression, ListValue)->values)
+            value = evaluate_expression(value);
+        return expression;
+    }
+
+    if (IS_PTR(expression, Unary))
+        return evaluate_unary(AS_PTR(expression, Unary));
+
+    if (IS_PTR(expression, Binary))
+        return evaluate_binary(AS_PTR(expression, Binary));
+
+    if (IS_PTR(expression, InstanceList))
+    {
+        for (auto &value : AS_PTR(expression, InstanceList)->values)
+            value = evaluate_expression(value);
+        return expression;
+    }
+
+    if (IS_PTR(expression, IndexWithExpression))
+    {
+        auto index_with_expression = AS_PTR(expression, IndexWithExpression);
+        index_with_expression->subject = evaluate_expression(index_with_expression->subject);
+        index_with_expression->index = evaluate_expression(index_with_expression->index);
+
+        // Indexing a constant list with a constant index
+        auto list = constant_of(index_with_expression->subject);
+        auto index = constant_of(index_with_expression->index);
+        if (list.has_value() && index.has_value() && IS_PTR(list.value(), ListValue) && IS_PTR(index.value(), PrimitiveValue))
+        {
+            auto &values = AS_PTR(list.value(), ListValue)->values;
+            auto &i = AS_PTR(index.value(), PrimitiveValue)->value;
+            if (IS(i, int) && AS(i, int) >= 1 && (size_t)AS(i, int) <= values.size())
+                return values[AS(i, int) - 1];
+        }
+
+        return expression;
+    }
+
+    if (IS_PTR(expression, ListOperation))
+    {
+        auto list_operation = AS_PTR(expression, ListOperation);
+        list_operation->list = evaluate_expression(list_operation->list);
+        list_operation->body = evaluate_expression(list_operation->body);
+        return expression;
+    }
+
+    if (IS_PTR(expression, EntitySelector))
+    {
+        auto entity_selector = AS_PTR(expression, EntitySelector);
+        entity_selector->value = evaluate_expression(entity_selector->value);
+        return expression;
+    }
+
+    if (IS_PTR(expression, Call))
+    {
+        auto call = AS_PTR(expression, Call);
+        call->callee = evaluate_expression(call->callee);
+        for (auto &argument : call->arguments)
+            argument.value = evaluate_expression(argument.value);
+        return expression;
+    }
+
+    if (IS_PTR(expression, PropertyAccess))
+    {
+        auto property_access = AS_PTR(expression, PropertyAccess);
+        property_access->subject = evaluate_expression(property_access->subject);
+        return expression;
+    }
+
+    if (IS_PTR(expression, ChooseExpression))
+    {
+        auto choose = AS_PTR(expression, ChooseExpression);
+        choose->player = evaluate_expression(choose->player);
+        choose->prompt = evaluate_expression(choose->prompt);
+        choose->choices = evaluate_expression(choose->choices);
+        if (choose->count.has_value())
+            choose->count = evaluate_expression(choose->count.value());
+        return expression;
+    }
+
+    if (IS_PTR(expression, IfExpression))
+        return evaluate_if_expression(AS_PTR(expression, IfExpression));
+
+    if (IS_PTR(expression, MatchExpression))
+        return evaluate_match_expression(AS_PTR(expression, MatchExpression));
+
+    return expression;
+}
+
+Expression Evaluator::evaluate_unary(ptr<Unary> unary)
+{
+    unary->value = evaluate_expression(unary->value);
+
+    auto constant = constant_of(unary->value);
+
+    // The count of a constant list
+    if (unary->op == "#" && constant.has_value() && IS_PTR(constant.value(), ListValue))
+    {
+        auto result = CREATE(PrimitiveValue);
+        result->value = (int)AS_PTR(constant.value(), ListValue)->values.size();
+        result->type = Intrinsic::type_amt;
+        return result;
+    }
+
+    if (!constant.has_value() || !IS_PTR(constant.value(), PrimitiveValue))
+        return unary;
+
+    auto value = AS_PTR(constant.value(), PrimitiveValue)->value;
+    auto result = CREATE(PrimitiveValue);
+
+    if (unary->op == "not" && IS(value, bool))
+    {
+        result->value = !AS(value, bool);
+        result->type = Intrinsic::type_bool;
+    }
+    else if (unary->op == "-" && IS(value, int) && AS(value, int) != numeric_limits<int>::min())
+    {
+        result->value = -AS(value, int);
+        result->type = Intrinsic::type_int;
+    }
+    else if (unary->op == "-" && IS(value, double))
+    {
+        result->value = -AS(value, double);
+        result->type = Intrinsic::type_num;
+    }
+    else if (unary->op == "+" && (IS(value, int) || IS(value, double)))
+    {
+        return constant.value();
+    }
+    else
+    {
+        return unary;
+    }
+
+    return result;
+}
+
+Expression Evaluator::evaluate_binary(ptr<Binary> binary)
+{
+    binary->lhs = evaluate_expression(binary->lhs);
+    binary->rhs = evaluate_expression(binary->rhs);
+
+    auto lhs_constant = constant_of(binary->lhs);
+    auto rhs_constant = constant_of(binary->rhs);
+    if (!lhs_constant.has_value() || !rhs_constant.has_value())
+        return binary;
+
+    auto op = binary->op;
+    auto result = CREATE(PrimitiveValue);
+
+    // Enum values are only compared
+    if (IS_PTR(lhs_constant.value(), EnumValue) && IS_PTR(rhs_constant.value(), EnumValue) && (op == "==" || op == "!="))
+    {
+        bool equal = AS_PTR(lhs_constant.value(), EnumValue) == AS_PTR(rhs_constant.value(), EnumValue);
+        result->value = op == "==" ? equal : !equal;
+        result->type = Intrinsic::type_bool;
+        return result;
+    }
+
+    if (!IS_PTR(lhs_constant.value(), PrimitiveValue) || !IS_PTR(rhs_constant.value(), PrimitiveValue))
+        return binary;
+
+    auto lhs_value = AS_PTR(lhs_constant.value(), PrimitiveValue);
+    auto rhs_value = AS_PTR(rhs_constant.value(), PrimitiveValue);
+    auto &lhs = lhs_value->value;
+    auto &rhs = rhs_value->value;
+
+    if (op == "and" || op == "or")
+    {
+        if (!IS(lhs, bool) || !IS(rhs, bool))
+            return binary;
+
+        result->value = op == "and" ? AS(lhs, bool) && AS(rhs, bool) : AS(lhs, bool) || AS(rhs, bool);
+        result->type = Intrinsic::type_bool;
+        return result;
+    }
+
+    if (op == "==" || op == "!=")
+    {
+        // Values of different kinds (e.g. `1 == 1.0`) are left to the generated program
+        if (lhs.index() != rhs.index())
+            return binary;
+
+        bool equal = lhs == rhs;
+        result->value = op == "==" ? equal : !equal;
+        result->type = Intrinsic::type_bool;
+        return result;
+    }
+
+    bool is_number = (IS(lhs, int) || IS(lhs, double)) && (IS(rhs, int) || IS(rhs, double));
+    if (!is_number)
+        return binary;
+
+    double lhs_number = IS(lhs, int) ? AS(lhs, int) : AS(lhs, double);
+    double rhs_number = IS(rhs, int) ? AS(rhs, int) : AS(rhs, double);
+
+    if (op == "<" || op == "<=" || op == ">" || op == ">=")
+    {
+        result->value = op == "<"    ? lhs_number < rhs_number
+                        : op == "<=" ? lhs_number <= rhs_number
+                        : op == ">"  ? lhs_number > rhs_number
+                                     : lhs_number >= rhs_number;
+        result->type = Intrinsic::type_bool;
+        return result;
+    }
+
+    // Division always results in a `num`, matching the converter
+    if (op == "/")
+    {
+        if (rhs_number == 0)
+            return binary;
+
+        result->value = lhs_number / rhs_number;
+        result->type = Intrinsic::type_num;
+        return result;
+    }
+
+    if (op != "+" && op != "-" && op != "*")
+        return binary;
+
+    if (IS(lhs, int) && IS(rhs, int))
+    {
+        long long a = AS(lhs, int), b = AS(rhs, int);
+        long long value = op == "+" ? a + b : op == "-" ? a - b
+                                                        : a * b;
+
+        // Overflow is left to happen at runtime, as it would without folding
+        if (value < numeric_limits<int>::min() || value > numeric_limits<int>::max())
+            return binary;
+
+        // The sum or product of two amounts is still an amount, as it cannot be negative
+        bool is_amount = lhs_value->type == Intrinsic::type_amt && rhs_value->type == Intrinsic::type_amt && op != "-";
+        result->value = (int)value;
+        result->type = is_amount ? Intrinsic::type_amt : Intrinsic::type_int;
+        return result;
+    }
+
+    result->value = op == "+" ? lhs_number + rhs_number : op == "-" ? lhs_number - rhs_number
+                                                                    : lhs_number * rhs_number;
+    result->type = Intrinsic::type_num;
+    return result;
+}
+
+// NOTE: Rules whose condition is known to be false are removed. If the first remaining rule is
+//       known to be chosen, the expression is replaced by its result.
+Expression Evaluator::evaluate_if_expression(ptr<IfExpression> if_expression)
+{
+    vector<IfExpression::Rule> rules;
+    for (auto rule : if_expression->rules)
+    {
+        rule.condition = evaluate_expression(rule.condition);
+        rule.result = evaluate_expression(rule.result);
+
+        auto condition = constant_of(rule.condition);
+        bool is_constant = condition.has_value() &&
+                           IS_PTR(condition.value(), PrimitiveValue) &&
+                           IS(AS_PTR(condition.value(), PrimitiveValue)->value, bool);
+
+        if (is_constant && !AS(AS_PTR(condition.value(), PrimitiveValue)->value, bool))
+            continue;
+
+        if (is_constant && rules.size() == 0)
+            return rule.result;
+
+        rules.push_back(rule);
+    }
+
+    // The else rule may have been removed along with the rest, in which case nothing matches at runtime
+    if (rules.size() == 0)
+        return if_expression;
+
+    if_expression->rules = rules;
+    return if_expression;
+}
+
+Expression Evaluator::evaluate_match_expression(ptr<MatchExpression> match)
+{
+    match->subject = evaluate_expression(match->subject);
+    for (auto &rule : match->rules)
+        rule.result = evaluate_expression(rule.result);
+
+    auto subject = constant_of(match->subject);
+    if (!subject.has_value())
+        return match;
+
+    // Rules are tried in order, until one is known to match. Any rule that may or may not match
+    // (e.g. a type pattern) stops the evaluation.
+    for (auto &rule : match->rules)
+    {
+        auto matched = matches(subject.value(), rule.pattern);
+        if (!matched.has_value())
+            return match;
+        if (matched.value())
+            return rule.result;
+    }
+
+    return match;
+}
+
+// PATTERNS //
+
+// The resolver leaves the sizes of list types unresolved, so only sizes made of literal numbers are evaluated
+void Evaluator::evaluate_pattern(Pattern pattern)
+{
+    if (IS_PTR(pattern, PatternLiteral))
+        evaluate_pattern(AS_PTR(pattern, PatternLiteral)->pattern);
+
+    else if (IS_PTR(pattern, ListType))
+    {
+        auto list_type = AS_PTR(pattern, ListType);
+        if (list_type->fixed_size.has_value())
+            list_type->fixed_size = evaluate_expression(list_type->fixed_size.value());
+        evaluate_pattern(list_type->list_of);
+    }
+
+    else if (IS_PTR(pattern, UnionPattern))
+    {
+        for (auto sub_pattern : AS_PTR(pattern, UnionPattern)->patterns)
+            evaluate_pattern(sub_pattern);
+    }
+}
+
+void Evaluator::evaluate_variable(ptr<Variable> variable)
+{
+    evaluate_pattern(variable->pattern);
+}
+
+// VALUES //
+
+// The value of an expression if it is known at compile time
+optional<Expression> Evaluator::constant_of(Expression expression)
+{
+    if (IS_PTR(expression, ExpressionLiteral))
+        return constant_of(AS_PTR(expression, ExpressionLiteral)->expr);
+
+    if (IS(expression, UnresolvedLiteral) && IS_PTR(AS(expression, UnresolvedLiteral), PrimitiveLiteral))
+        return constant_of(AS_PTR(AS(expression, UnresolvedLiteral), PrimitiveLiteral)->value);
+
+    if (IS_PTR(expression, InstanceList) && AS_PTR(expression, InstanceList)->values.size() == 1)
+        return constant_of(AS_PTR(expression, InstanceList)->values[0]);
+
+    if (IS_PTR(expression, PrimitiveValue))
+    {
+        // `none` takes the type of what it is compared to, so it is left to the converter
+        if (AS_PTR(expression, PrimitiveValue) == Intrinsic::none_val)
+            return {};
+        return expression;
+    }
+
+    if (IS_PTR(expression, EnumValue))
+        return expression;
+
+    if (IS_PTR(expression, ListValue))
+    {
+        for (auto value : AS_PTR(expression, ListValue)->values)
+            if (!constant_of(value).has_value())
+                return {};
+        return expression;
+    }
+
+    return {};
+}
+
+// Whether a constant value matches a pattern, if it is known at compile time
+optional<bool> Evaluator::matches(Expression value, Pattern pattern)
+{
+    if (IS_PTR(pattern, PatternLiteral))
+        return matches(value, AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, AnyPattern))
+        return true;
+
+    if (IS_PTR(pattern, EnumValue))
+    {
+        if (!IS_PTR(value, EnumValue))
+            return {};
+        return AS_PTR(value, EnumValue) == AS_PTR(pattern, EnumValue);
+    }
+
+    if (IS_PTR(pattern, PrimitiveValue))
+    {
+        auto pattern_value = AS_PTR(pattern, PrimitiveValue);
+        if (!IS_PTR(value, PrimitiveValue) || pattern_value == Intrinsic::none_val)
+            return {};
+
+        auto &a = AS_PTR(value, PrimitiveValue)->value;
+        auto &b = pattern_value->value;
+        if (a.index() != b.index())
+            return {};
+        return a == b;
+    }
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        bool any_unknown = false;
+        for (auto sub_pattern : AS_PTR(pattern, UnionPattern)->patterns)
+        {
+            auto matched = matches(value, sub_pattern);
+            if (!matched.has_value())
+                any_unknown = true;
+            else if (matched.value())
+                return true;
+        }
+        if (any_unknown)
+            return {};
+        return false;
+    }
+
+    return {};
+}
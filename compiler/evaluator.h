@@ -0,0 +1,42 @@
+#pragma once
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "apm.h"
+#include "utilty.h"
+using namespace std;
+
+// NOTE: Runs between the checker and the converter. Operations on values that are known at compile
+//       time are replaced by their result, and `if` and `match` expressions whose outcome is known
+//       are replaced by the result of the rule that is chosen. The sizes of list types are evaluated
+//       too, so that the converter can store fixed size lists inline.
+class Evaluator
+{
+public:
+    void evaluate(ptr<Program> program);
+
+private:
+    // PROGRAM STRUCTURE //
+    void evaluate_scope_lookup_value(Scope::LookupValue value);
+    void evaluate_code_block(ptr<CodeBlock> code_block);
+
+    // STATEMENTS //
+    void evaluate_statement(Statement &statement);
+
+    // EXPRESSIONS //
+    [[nodiscard]] Expression evaluate_expression(Expression expression);
+    [[nodiscard]] Expression evaluate_unary(ptr<Unary> unary);
+    [[nodiscard]] Expression evaluate_binary(ptr<Binary> binary);
+    [[nodiscard]] Expression evaluate_if_expression(ptr<IfExpression> if_expression);
+    [[nodiscard]] Expression evaluate_match_expression(ptr<MatchExpression> match);
+
+    // PATTERNS //
+    void evaluate_pattern(Pattern pattern);
+    void evaluate_variable(ptr<Variable> variable);
+
+    // VALUES //
+    [[nodiscard]] optional<Expression> constant_of(Expression expression);
+    [[nodiscard]] optional<bool> matches(Expression value, Pattern pattern);
+};
+
+#endif
@@ -6,6 +6,7 @@ enum class Precedence
 { // Happens last
     None,
     Choose,
+    ListOperation,
     LogicalOr,
     LogicalAnd,
     CompareEqual,
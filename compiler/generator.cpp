@@ -1,235 +1,1466 @@
 #include "json.h"
 #include "errors.h"
 #include "generator.h"
+#include "trace.h"
+#include <charconv>
 
-string Generator::generate(C_Program representation)
+size_t Generator::generate(const C_Program &representation, ostream &output)
 {
-    ir = representation;
+    TraceScope trace("Generator::generate");
+    this->output = &output;
+    characters_written = 0;
+    buffer.clear();
+    buffer.reserve(buffer_capacity);
+
+    ir = &representation;
     generate_program(representation);
-    return source;
+    flush();
+    ir = nullptr;
+
+    return characters_written;
+}
+
+void Generator::write(string_view token)
+{
+    if (buffer.size() + token.size() + 1 > buffer_capacity)
+        flush();
+
+    buffer.append(token);
+    buffer.push_back(' ');
 }
 
-void Generator::write(string token)
+void Generator::write(int value)
 {
-    source += token + " ";
+    char digits[16];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    write(string_view(digits, result.ptr - digits));
 }
 
-void Generator::generate_program(C_Program program)
+void Generator::write(double value)
 {
-    // Includes
-    write("#include <cstddef>\n");
-    write("#include <stdbool.h>\n");
-    write("#include <string>\n");
+    // Shortest representation that reads back as the same value, with a decimal point
+    // so that the C compiler still treats it as a double.
+    char digits[32];
+    auto result = to_chars(digits, digits + sizeof(digits) - 2, value);
+    string_view written(digits, result.ptr - digits);
+    if (written.find_first_of(".einf") == string_view::npos)
+    {
+        *result.ptr++ = '.';
+        *result.ptr++ = '0';
+    }
+    write(string_view(digits, result.ptr - digits));
+}
+
+void Generator::flush()
+{
+    characters_written += buffer.size();
+    output->write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void Generator::generate_program(const C_Program &program)
+{
+    write("#include \"gambit/runtime.h\"\n");
+    write("#include \"gambit/search.h\"\n");
+
+    // Entity types
+    for (const auto &entity : program.entities)
+    {
+        write("typedef uint32_t");
+        write(entity.identity);
+        write(";\n");
+    }
 
-    // Gambit types
-    write("#define GambitEntity int\n");
+    // Enum types
+    for (const auto &c_enum : program.enums)
+        generate_enum(c_enum);
+
+    // Constant lists
+    for (const auto &static_list : program.static_lists)
+    {
+        if (static_list.is_lookup_table)
+        {
+            const auto &value = ir->expressions[static_list.value];
+            write("static const");
+            generate_type(ir->types[static_list.type].index);
+            write(static_list.identity);
+            write("[ ] = {");
+            for (size_t i = 0; i < value.argument_count; i++)
+            {
+                generate_expression(ir->arguments[value.first_argument + i]);
+                write(",");
+            }
+            write("} ;\n");
+            continue;
+        }
+
+        write("static const");
+        generate_type(static_list.type);
+        write(static_list.identity);
+        write("=");
+        generate_expression(static_list.value);
+        write(";\n");
+    }
+
+    // State
+    write("struct GambitState {\n");
+    write("uint64_t hash ;\n");
+    write("uint64_t property_hash [");
+    write((int)max(program.state_properties.size(), (size_t)1));
+    write("] ;\n");
+    for (size_t i = 0; i < program.entities.size(); i++)
+        generate_entity_storage(i);
+
+    for (const auto &state : program.state_properties)
+        if (state.storage != C_StateProperty::ENTITY_COLUMN)
+            generate_table(state);
+    bool has_arena = generate_arena();
+    write("} ;\n");
+
+    write("static_assert ( std::is_trivially_copyable < GambitState > :: value , \"The game state must be cloned with memcpy\" ) ;\n");
+    // Each thread plays its own copy of the game
+    write("thread_local GambitState gambit_state ;\n");
+
+    // A clone of the state of the thread keeps its own copy of the overflow of the arena, so that it
+    // can be restored on any thread
+    write("void gambit_clone ( gambit::Clone < GambitState > & to ) { gambit::clone ( to , gambit_state ) ; }\n");
+    write("void gambit_restore ( const gambit::Clone < GambitState > & from ) {");
+    if (has_arena)
+        write("gambit::use_arena ( gambit_state . gambit_arena ) ;");
+    write("gambit::restore ( gambit_state , from ) ; }\n");
+    write("uint64_t gambit_hash ( ) { return gambit_state . hash ; }\n");
+
+    // Caches of memoised functions are kept outside of the state, so that cloning the state stays cheap
+    for (const auto &funct : program.functions)
+    {
+        if (!funct.memoised)
+            continue;
+
+        size_t cache_size = 1;
+        for (auto parameter : funct.parameters)
+            cache_size *= table_dimension(parameter);
+
+        write("thread_local gambit::Cache <");
+        generate_type(funct.return_type);
+        write(">");
+        write(funct.cache_identity);
+        write("[");
+        write((int)cache_size);
+        write("] ;\n");
+    }
+
+    // The game is the first entity created
+    if (program.intrinsics.game_variable != C_NO_INDEX)
+    {
+        write("const");
+        generate_variable(program.intrinsics.game_variable);
+        write("= 1 ;\n");
+    }
 
     // Function forward declarations
-    for (auto funct : program.functions)
+    for (const auto &entity : program.entities)
+    {
+        write(entity.identity);
+        write(entity.create_function);
+        write("( ) ;\n");
+    }
+
+    for (const auto &funct : program.functions)
     {
         generate_function_signature(funct);
-        write(";");
+        write(";\n");
     }
 
     // Function declarations
-    for (auto funct : program.functions)
-    {
+    for (size_t i = 0; i < program.entities.size(); i++)
+        generate_create_function(i);
+
+    generate_setup_function();
+
+    for (const auto &funct : program.functions)
         generate_function_declaration(funct);
+
+    // Entry point
+    // The game is played from the start by both the game and the search. A program without a main
+    // procedure only sets up its state, and so is always a draw.
+    write("void gambit_play ( ) {\n");
+    write("gambit_setup ( ) ;\n");
+    if (program.intrinsics.main_function != C_NO_INDEX)
+    {
+        write(program.functions[program.intrinsics.main_function].identity);
+        write("( ) ;\n");
     }
+    write("}\n");
+
+    // The evaluation of a player, for searches that stop before the end of the game
+    bool has_evaluation = program.intrinsics.evaluation_function != C_NO_INDEX;
+    if (has_evaluation)
+    {
+        write("double gambit_evaluate ( uint32_t player ) {\n");
+        write("return double (");
+        write(program.functions[program.intrinsics.evaluation_function].identity);
+        write("(");
+        generate_type(ir->variables[program.functions[program.intrinsics.evaluation_function].parameters[0]].type);
+        write("( player ) ) ) ;\n");
+        write("}\n");
+    }
+
+    bool has_hidden_state = generate_determinise_function();
+
+    // A host that drives the game itself, such as through sessions, includes the program without its entry point
+    write("#ifndef GAMBIT_NO_MAIN\n");
+    write("int main ( int argc , char * * argv ) {\n");
+    write("return gambit::run ( argc , argv , gambit_state , gambit_play , gambit_hash ,");
+    write(has_evaluation ? "gambit_evaluate" : "nullptr");
+    write(",");
+    write(has_hidden_state ? "gambit_determinise" : "nullptr");
+    write(") ;\n");
+    write("}\n");
+    write("#endif\n");
 }
-void Generator::generate_function_signature(C_Function funct)
+
+// TYPES AND STORAGE
+
+void Generator::generate_type(size_t type)
 {
-    write("void"); // TODO: Return type
-    write(funct.identity);
-    write("()"); // TODO: Parameters
+    const auto &c_type = ir->types.at(type);
+    switch (c_type.kind)
+    {
+    case C_Type::VOID:
+        write("void");
+        break;
+    case C_Type::BOOL:
+        write("bool");
+        break;
+    case C_Type::INT:
+        write("int32_t");
+        break;
+    case C_Type::DOUBLE:
+        write("double");
+        break;
+    case C_Type::STRING:
+        write("const char *");
+        break;
+    case C_Type::ENUM:
+        write(ir->enums[c_type.index].identity);
+        break;
+    case C_Type::ENTITY:
+        write(ir->entities[c_type.index].identity);
+        break;
+    case C_Type::LIST:
+        if (c_type.capacity > 0)
+        {
+            write("gambit::List <");
+            generate_type(c_type.index);
+            write(",");
+            write((int)c_type.capacity);
+            write(">");
+            break;
+        }
+        write("std::vector<");
+        generate_type(c_type.index);
+        write(">");
+        break;
+    }
 }
 
-void Generator::generate_function_declaration(C_Function funct)
+// Lists in the state block are stored inline, or in the arena of the block, so that the block can be copied with `memcpy`
+void Generator::generate_state_type(size_t type)
 {
-    generate_function_signature(funct);
+    const auto &c_type = ir->types.at(type);
+    if (c_type.kind != C_Type::LIST)
+    {
+        generate_type(type);
+        return;
+    }
 
-    size_t first_stmt = funct.body + 1;
-    auto block = ir.statements[funct.body];
-    size_t last_stmt = funct.body + block.statement_count;
+    if (c_type.fixed_size == 0)
+    {
+        write("gambit::Buffer <");
+        generate_state_type(c_type.index);
+        write(">");
+        return;
+    }
 
-    vector<size_t> close_block_after;
-    // FIXME: This will cause a segmentation fault if ever `last_stmt` is 0
-    close_block_after.push_back(last_stmt);
+    write("gambit::List <");
+    generate_state_type(c_type.index);
+    write(",");
+    write((int)c_type.fixed_size);
+    write(">");
+}
 
-    write("{");
-    for (size_t i = first_stmt; i <= last_stmt; i++)
+// NOTE: `none` is represented by the value initialised value of the type, which is 0 for
+//       entities and enums, and a null pointer for strings.
+void Generator::generate_default_value(size_t type)
+{
+    const auto &c_type = ir->types.at(type);
+    if (c_type.kind == C_Type::STRING)
     {
-        C_Statement stmt = ir.statements[i];
-        switch (stmt.kind)
-        {
-        case C_Statement::INVALID:
-            throw CompilerError("Attempt to generate Invalid C Statement");
+        write(c_type.optional ? "nullptr" : "\"\"");
+        return;
+    }
+
+    generate_type(type);
+    write("( )");
+}
+
+void Generator::generate_enum(const C_Enum &c_enum)
+{
+    write("enum");
+    write(c_enum.identity);
+    write(": uint8_t {");
+    for (size_t i = 0; i < c_enum.values.size(); i++)
+    {
+        write(c_enum.values[i]);
+        if (i == 0)
+            write("= 1");
+        write(",");
+    }
+    write("} ;\n");
+
+    write("const char * const");
+    write(c_enum.names_identity);
+    write("[ ] = { \"none\" ,");
+    for (const auto &name : c_enum.names)
+    {
+        write(to_json(name));
+        write(",");
+    }
+    write("} ;\n");
+}
+
+// The number of values a parameter of a table can take, including `none`
+size_t Generator::table_dimension(size_t parameter)
+{
+    const auto &type = ir->types[ir->variables[parameter].type];
+    if (type.kind == C_Type::ENTITY)
+        return ir->entities[type.index].capacity + 1;
+    if (type.kind == C_Type::ENUM)
+        return ir->enums[type.index].values.size() + 1;
+    return 2;
+}
 
-        case C_Statement::IF_STATEMENT:
+void Generator::generate_state_declaration(const C_StateProperty &state, size_t length)
+{
+    if (state.packed_bits > 0)
+    {
+        write("gambit::Packed <");
+        generate_type(state.type);
+        write(",");
+        write((int)state.packed_bits);
+        write(",");
+        write((int)length);
+        write(">");
+        write(state.identity);
+    }
+    else
+    {
+        generate_state_type(state.type);
+        write(state.identity);
+        write("[");
+        write((int)length);
+        write("]");
+    }
+    write(";\n");
+}
+
+void Generator::generate_entity_storage(size_t entity)
+{
+    const auto &c_entity = ir->entities[entity];
+
+    write("struct {\n");
+    write("uint32_t count ;\n");
+
+    // Ids start at 1, so the first element of each column is unused
+    for (const auto &state : ir->state_properties)
+        if (state.storage == C_StateProperty::ENTITY_COLUMN && state.entity == entity)
+            generate_state_declaration(state, c_entity.capacity + 1);
+
+    for (const auto &state : ir->state_properties)
+    {
+        if (state.storage != C_StateProperty::ENTITY_COLUMN || state.entity != entity || state.reverse_index.empty())
+            continue;
+
+        write("gambit::ReverseIndex <");
+        write((int)state.reverse_index_values);
+        write(",");
+        write((int)c_entity.capacity + 1);
+        write(">");
+        write(state.reverse_index);
+        write(";\n");
+    }
+
+    write("}");
+    write(c_entity.storage);
+    write(";\n");
+}
+
+// NOTE: The arena has room for each list to grow to twice its expected capacity, as lists move
+//       to a larger region when they are full, and for each sparse table to grow once. Regions
+//       that do not fit are allocated from the overflow of the arena. Returns whether the state has
+//       an arena.
+bool Generator::generate_arena()
+{
+    bool has_arena = false;
+    for (const auto &state : ir->state_properties)
+    {
+        if (state.storage == C_StateProperty::SPARSE_TABLE)
         {
-            write("if (");
-            generate_expression(stmt.expression);
-            write(")");
-            break;
+            write(has_arena ? "+" : "gambit::Arena <");
+            write((int)(3 * state.sparse_capacity));
+            write("* ( sizeof ( uint32_t ) + sizeof (");
+            generate_type(state.type);
+            write(") )");
+            has_arena = true;
+            continue;
         }
 
-        case C_Statement::ELSE_IF_STATEMENT:
+        if (state.list_capacity == 0)
+            continue;
+
+        size_t lists = 1;
+        if (state.storage == C_StateProperty::ENTITY_COLUMN)
+            lists = ir->entities[state.entity].capacity + 1;
+        else
+            for (auto parameter : state.parameters)
+                lists *= table_dimension(parameter);
+
+        write(has_arena ? "+" : "gambit::Arena <");
+        write((int)(2 * lists * state.list_capacity));
+        write("* sizeof (");
+        generate_state_type(ir->types[state.type].index);
+        write(")");
+        has_arena = true;
+    }
+
+    if (has_arena)
+        write("> gambit_arena ;\n");
+    return has_arena;
+}
+
+// NOTE: Tables are flattened into a single array, indexed by each parameter in turn
+void Generator::generate_table(const C_StateProperty &state)
+{
+    if (state.storage == C_StateProperty::SPARSE_TABLE)
+    {
+        write("gambit::Sparse <");
+        generate_type(state.type);
+        write(",");
+        write((int)state.sparse_capacity);
+        write(">");
+        write(state.identity);
+        write(";\n");
+        return;
+    }
+
+    size_t length = 1;
+    for (auto parameter : state.parameters)
+        length *= table_dimension(parameter);
+
+    generate_state_declaration(state, length);
+}
+
+void Generator::generate_state_index(const C_StateProperty &state, const function<void(size_t)> &generate_argument)
+{
+    if (state.storage == C_StateProperty::ENTITY_COLUMN)
+    {
+        generate_argument(0);
+        return;
+    }
+
+    generate_flat_index(state.parameters, generate_argument);
+}
+
+// The index of a combination of arguments in a flattened table, indexed by each parameter in turn
+void Generator::generate_flat_index(const vector<size_t> &parameters, const function<void(size_t)> &generate_argument)
+{
+    if (parameters.size() == 0)
+    {
+        write("0");
+        return;
+    }
+
+    for (size_t i = 1; i < parameters.size(); i++)
+        write("(");
+
+    for (size_t i = 0; i < parameters.size(); i++)
+    {
+        if (i > 0)
         {
-            write("else if (");
-            generate_expression(stmt.expression);
-            write(")");
-            break;
+            write("*");
+            write((int)table_dimension(parameters[i]));
+            write("+");
         }
+        write("size_t (");
+        generate_argument(i);
+        write(")");
+        if (i > 0)
+            write(")");
+    }
+}
+
+void Generator::generate_state_reference(const C_StateProperty &state)
+{
+    write("gambit_state .");
+    if (state.storage == C_StateProperty::ENTITY_COLUMN)
+    {
+        write(ir->entities[state.entity].storage);
+        write(".");
+    }
+    write(state.identity);
+}
+
+void Generator::generate_state_read(const C_StateProperty &state, const function<void(size_t)> &generate_argument)
+{
+    generate_state_reference(state);
+    bool is_get = state.packed_bits > 0 || state.storage == C_StateProperty::SPARSE_TABLE;
+    write(is_get ? ". get (" : "[");
+    generate_state_index(state, generate_argument);
+    write(is_get ? ")" : "]");
+}
+
+// NOTE: Every write to the state goes through the runtime, which keeps the Zobrist hash of the
+//       state up to date. Each state property and entity type has its own key.
+void Generator::generate_state_write(const C_StateProperty &state, const function<void(size_t)> &generate_argument, size_t value)
+{
+    // A list written to the state is copied into it, so a list literal is given as an
+    // initializer list, rather than built on the heap first
+    const auto &expr = ir->expressions[value];
+    if (expr.kind == C_Expression::LIST_LITERAL && ir->types[state.type].kind == C_Type::LIST)
+    {
+        generate_state_write(state, generate_argument, [&]()
+                             {
+            write("std::initializer_list <");
+            generate_state_type(ir->types[state.type].index);
+            write("> {");
+            for (size_t i = 0; i < expr.argument_count; i++)
+            {
+                if (i > 0)
+                    write(",");
+                generate_expression(ir->arguments[expr.first_argument + i]);
+            }
+            write("}"); });
+        return;
+    }
+
+    generate_state_write(state, generate_argument, [&]()
+                         { generate_expression(value); });
+}
+
+void Generator::generate_state_write(const C_StateProperty &state, const function<void(size_t)> &generate_argument, const function<void()> &generate_value)
+{
+    write("gambit::assign ( gambit_state . hash , gambit_state . property_hash [");
+    write((int)state_key(state) - 1);
+    write("] ,");
+    write((int)state_key(state));
+    write(",");
+    generate_state_reference(state);
+    write(",");
+    generate_state_index(state, generate_argument);
+    write(",");
+    generate_value();
+    if (!state.reverse_index.empty())
+    {
+        write(", gambit_state .");
+        write(ir->entities[state.entity].storage);
+        write(".");
+        write(state.reverse_index);
+    }
+    write(")");
+}
+
+// Lists of state are modified in place, and are hashed again once the modification is made
+void Generator::generate_state_modification(const C_Expression &access, const function<void()> &generate_modification)
+{
+    const auto &state = ir->state_properties.at(access.target);
+    write("gambit::modify ( gambit_state . hash , gambit_state . property_hash [");
+    write((int)state_key(state) - 1);
+    write("] ,");
+    write((int)state_key(state));
+    write(",");
+    generate_state_reference(state);
+    write(",");
+    generate_state_index(state, [&](size_t i)
+                         { generate_expression(ir->arguments[access.first_argument + i]); });
+    write(", [ & ] ( auto & list ) {");
+    generate_modification();
+    write("; } )");
+}
+
+size_t Generator::state_key(const C_StateProperty &state)
+{
+    return (&state - ir->state_properties.data()) + 1;
+}
+
+size_t Generator::entity_key(size_t entity)
+{
+    return ir->state_properties.size() + entity + 1;
+}
+
+void Generator::generate_create_function(size_t entity)
+{
+    const auto &c_entity = ir->entities[entity];
+
+    write(c_entity.identity);
+    write(c_entity.create_function);
+    write("( ) {\n");
+
+    write("if ( gambit_state .");
+    write(c_entity.storage);
+    write(". count ==");
+    write((int)c_entity.capacity);
+    write(") gambit::error (");
+    string too_many = "Too many " + c_entity.name + " entities were created.";
+    if (!c_entity.capacity_determined)
+        too_many += " The compiler's --entity-capacity option allows more.";
+    write(to_json(too_many));
+    write(") ;\n");
+
+    write(c_entity.identity);
+    write("entity = gambit::increment ( gambit_state . hash ,");
+    write((int)entity_key(entity));
+    write(", gambit_state .");
+    write(c_entity.storage);
+    write(". count ) ;\n");
 
-        case C_Statement::ELSE_STATEMENT:
+    for (const auto &state : ir->state_properties)
+    {
+        if (state.storage != C_StateProperty::ENTITY_COLUMN || state.entity != entity)
+            continue;
+
+        // The initial value can refer to the entity through the parameter of the state property
+        write("{ [[maybe_unused]]");
+        generate_variable(state.parameters[0]);
+        write("= entity ;");
+        generate_state_write(state, [&](size_t)
+                             { write("entity"); },
+                             state.initial_value);
+        write("; }\n");
+    }
+
+    write("return entity ;\n");
+    write("}\n");
+}
+
+void Generator::generate_setup_function()
+{
+    write("void gambit_setup ( ) {\n");
+    write("gambit::reset ( gambit_state ) ;\n");
+    for (const auto &state : ir->state_properties)
+    {
+        if (state.list_capacity > 0 || state.storage == C_StateProperty::SPARSE_TABLE)
         {
-            write("else");
+            write("gambit::use_arena ( gambit_state . gambit_arena ) ;\n");
             break;
         }
+    }
 
-        case C_Statement::FOR_LOOP:
+    // Every combination of parameters of a table is initialised, including `none`. Sparse tables
+    // only need the value of the entries they don't store.
+    for (const auto &state : ir->state_properties)
+    {
+        if (state.storage == C_StateProperty::SPARSE_TABLE)
         {
-            // TODO: Implement
-            write("for ()");
-            break;
+            generate_state_reference(state);
+            write(". fallback =");
+            generate_expression(state.initial_value);
+            write(";\n");
+            continue;
         }
 
-        case C_Statement::WHILE_LOOP:
+        if (state.storage != C_StateProperty::TABLE)
+            continue;
+
+        for (size_t i = 0; i < state.parameters.size(); i++)
         {
-            write("while (true)");
-            break;
+            string counter = "gambit_index_" + to_string(i);
+            write("for ( size_t");
+            write(counter);
+            write("= 0 ;");
+            write(counter);
+            write("<");
+            write((int)table_dimension(state.parameters[i]));
+            write(";");
+            write(counter);
+            write("++ )\n");
         }
 
-        case C_Statement::RETURN_STATEMENT:
+        write("{");
+        for (size_t i = 0; i < state.parameters.size(); i++)
         {
-            write("return");
-            generate_expression(stmt.expression);
+            auto parameter = state.parameters[i];
+            write("[[maybe_unused]]");
+            generate_variable(parameter);
+            write("= (");
+            generate_type(ir->variables[parameter].type);
+            write(")");
+            write("gambit_index_" + to_string(i));
             write(";");
-            break;
         }
 
-        case C_Statement::VARIABLE_DECLARATION:
+        generate_state_write(state, [&](size_t i)
+                             { write("gambit_index_" + to_string(i)); },
+                             state.initial_value);
+        write("; }\n");
+    }
+
+    if (ir->intrinsics.game_entity != C_NO_INDEX)
+    {
+        write(ir->entities[ir->intrinsics.game_entity].create_function);
+        write("( ) ;\n");
+    }
+
+    write("}\n");
+}
+
+// NOTE: A search that plays as a player cannot see the hidden state of the other players, so it
+//       samples a state that looks the same to the player. The hidden values of each type are
+//       pooled, shuffled with the game's randomness, and dealt back out in the same order, so every
+//       list keeps its length and no value enters or leaves the game. The player's own state is
+//       left as it is. Each pool belongs to the thread and keeps its memory between samples, as
+//       the state is sampled once per simulation. Returns whether the game has any hidden state.
+bool Generator::generate_determinise_function()
+{
+    auto element_type = [&](const C_StateProperty &state)
+    {
+        const auto &type = ir->types[state.type];
+        return type.kind == C_Type::LIST ? type.index : state.type;
+    };
+
+    vector<size_t> pools;
+    for (const auto &state : ir->state_properties)
+        if (state.hidden && find(pools.begin(), pools.end(), element_type(state)) == pools.end())
+            pools.push_back(element_type(state));
+
+    if (pools.empty())
+        return false;
+
+    // Visits each entity whose value of the state is hidden from the player
+    auto generate_hidden_values = [&](const C_StateProperty &state, const function<void()> &generate_body)
+    {
+        write("for ( uint32_t entity = 1 ; entity <= gambit_state .");
+        write(ir->entities[state.entity].storage);
+        write(". count ; entity ++ ) {");
+        if (state.entity == ir->intrinsics.player_entity)
+            write("if ( entity == player ) continue ;");
+        generate_body();
+        write("}\n");
+    };
+
+    write("void gambit_determinise ( [[maybe_unused]] uint32_t player ) {\n");
+    for (auto pool : pools)
+    {
+        write("{ thread_local std::vector <");
+        generate_state_type(pool);
+        write("> pool ; pool . clear ( ) ;\n");
+
+        for (const auto &state : ir->state_properties)
         {
-            // TODO: Implement
-            write("int _ = 0;");
-            break;
+            if (!state.hidden || element_type(state) != pool)
+                continue;
+
+            generate_hidden_values(state, [&]()
+                                   {
+                bool is_list = ir->types[state.type].kind == C_Type::LIST;
+                write(is_list ? "for ( const auto & value :" : "pool . push_back (");
+                generate_state_read(state, [&](size_t)
+                                    { write("entity"); });
+                write(is_list ? ") pool . push_back ( value ) ;" : ") ;"); });
         }
 
-        case C_Statement::CODE_BLOCK:
+        write("gambit::shuffle ( pool ) ;\n");
+        write("size_t next = 0 ;\n");
+
+        for (const auto &state : ir->state_properties)
         {
-            if (stmt.statement_count != 1)
-            {
-                write("{");
-                close_block_after.push_back(i + stmt.statement_count);
-            }
-            break;
+            if (!state.hidden || element_type(state) != pool)
+                continue;
+
+            generate_hidden_values(state, [&]()
+                                   {
+                if (ir->types[state.type].kind != C_Type::LIST)
+                {
+                    generate_state_write(state, [&](size_t)
+                                         { write("entity"); },
+                                         [&]()
+                                         { write("pool [ next ++ ]"); });
+                    write(";");
+                    return;
+                }
+
+                write("gambit::modify ( gambit_state . hash , gambit_state . property_hash [");
+                write((int)state_key(state) - 1);
+                write("] ,");
+                write((int)state_key(state));
+                write(",");
+                generate_state_reference(state);
+                write(", entity , [ & ] ( auto & list ) { for ( auto & value : list ) value = pool [ next ++ ] ; } ) ;"); });
         }
+        write("}\n");
+    }
+    write("}\n");
+    return true;
+}
+
+// FUNCTIONS
 
-        case C_Statement::EXPRESSION_STATEMENT:
+void Generator::generate_variable(size_t variable)
+{
+    const auto &c_variable = ir->variables.at(variable);
+    if (c_variable.is_reference)
+        write("const");
+    generate_type(c_variable.type);
+    if (c_variable.is_reference)
+        write("&");
+    write(c_variable.identity);
+}
+
+void Generator::generate_function_signature(const C_Function &funct)
+{
+    generate_type(funct.return_type);
+    write(funct.identity);
+    write("(");
+
+    // Functions whose value does not depend on a parameter, such as `fn bool (num n).is_num: true`, do not use it
+    for (size_t i = 0; i < funct.parameters.size(); i++)
+    {
+        if (i > 0)
+            write(",");
+        write("[[maybe_unused]]");
+        generate_variable(funct.parameters[i]);
+    }
+    write(")");
+}
+
+void Generator::generate_function_declaration(const C_Function &funct)
+{
+    generate_function_signature(funct);
+    write("{\n");
+
+    // The result is reused while the state that the function reads has the same hash
+    if (funct.memoised)
+    {
+        write("auto & cached =");
+        write(funct.cache_identity);
+        write("[");
+        generate_flat_index(funct.parameters, [&](size_t i)
+                            { write(ir->variables[funct.parameters[i]].identity); });
+        write("] ;\n");
+
+        write("uint64_t stamp =");
+        for (size_t i = 0; i < funct.reads.size(); i++)
+            write("gambit::mix (");
+        write("uint64_t ( 0 )");
+        for (auto read : funct.reads)
         {
+            write("^ gambit_state . property_hash [");
+            write((int)read);
+            write("] )");
+        }
+        write(";\n");
+
+        write("if ( cached . valid && cached . stamp == stamp ) return cached . value ;\n");
+        write("cached . value = [ & ] ( ) ->");
+        generate_type(funct.return_type);
+        write("{\n");
+    }
+
+    generate_statement(funct.body);
+
+    // Functions that reach the end of their body without returning a value return `none`
+    if (ir->types[funct.return_type].kind != C_Type::VOID)
+    {
+        write("return");
+        generate_default_value(funct.return_type);
+        write(";\n");
+    }
+
+    if (funct.memoised)
+    {
+        write("} ( ) ;\n");
+        write("cached . stamp = stamp ;\n");
+        write("cached . valid = true ;\n");
+        write("return cached . value ;\n");
+    }
+
+    write("}\n");
+}
+
+// STATEMENTS
+
+// Generates the statement and any statements nested within it, returning the index of the next statement
+size_t Generator::generate_statement(size_t statement_index)
+{
+    const auto &stmt = ir->statements.at(statement_index);
+    size_t next = statement_index + 1;
+
+    switch (stmt.kind)
+    {
+    case C_Statement::INVALID:
+        throw CompilerError("Attempt to generate Invalid C Statement");
+
+    case C_Statement::IF_STATEMENT:
+    {
+        write("if (");
+        generate_expression(stmt.expression);
+        write(")");
+        return generate_statement(next);
+    }
+
+    case C_Statement::ELSE_IF_STATEMENT:
+    {
+        write("else if (");
+        generate_expression(stmt.expression);
+        write(")");
+        return generate_statement(next);
+    }
+
+    case C_Statement::ELSE_STATEMENT:
+    {
+        write("else");
+        return generate_statement(next);
+    }
+
+    case C_Statement::FOR_LOOP:
+    {
+        write("for (");
+        generate_variable(stmt.variable);
+        write(":");
+        generate_expression(stmt.expression);
+        write(")");
+        return generate_statement(next);
+    }
+
+    case C_Statement::WHILE_LOOP:
+    {
+        write("while ( true )");
+        return generate_statement(next);
+    }
+
+    case C_Statement::RETURN_STATEMENT:
+    {
+        write("return");
+        if (stmt.expression != C_NO_INDEX)
             generate_expression(stmt.expression);
+        write(";\n");
+        return next;
+    }
+
+    case C_Statement::VARIABLE_DECLARATION:
+    {
+        generate_variable(stmt.variable);
+        write("=");
+        generate_expression(stmt.expression);
+        write(";\n");
+        return next;
+    }
+
+    case C_Statement::WINS_STATEMENT:
+    {
+        write("gambit::wins (");
+        generate_expression(stmt.expression);
+        write(") ;\n");
+        return next;
+    }
+
+    case C_Statement::DRAW_STATEMENT:
+    {
+        write("gambit::draw ( ) ;\n");
+        return next;
+    }
+
+    case C_Statement::CODE_BLOCK:
+    {
+        size_t last = statement_index + stmt.statement_count;
+        write("{\n");
+        while (next <= last)
+            next = generate_statement(next);
+        write("}\n");
+        return next;
+    }
+
+    case C_Statement::EXPRESSION_STATEMENT:
+    {
+        generate_expression(stmt.expression);
+        write(";\n");
+        return next;
+    }
+    }
+
+    throw CompilerError("Could not generate C_Statement " + to_string(stmt.kind));
+}
+
+// EXPRESSIONS
+
+// NOTE: Pipelines are generated as a lambda that is called immediately, so that the loop can be
+//       used as an expression.
+void Generator::generate_pipeline(const C_Expression &expr)
+{
+    const auto &pipeline = ir->pipelines.at(expr.target);
+    bool is_count = pipeline.sink == C_Pipeline::COUNT;
+
+    write("[ & ] ( ) {");
+    write("const auto & gambit_source =");
+    generate_expression(pipeline.source);
+    write(";");
+
+    if (is_count)
+    {
+        write("int32_t gambit_result = 0 ;");
+    }
+    else
+    {
+        generate_type(expr.type);
+        write("gambit_result { } ;");
+        if (ir->types[expr.type].capacity == 0)
+            write("gambit_result . reserve ( gambit_source . size ( ) ) ;");
+    }
+
+    // Values that pass a chain of filters are counted without branching, so that the loop can be vectorised
+    bool is_branchless = is_count && all_of(pipeline.stages.begin(), pipeline.stages.end(), [](const C_Pipeline::Stage &stage)
+                                            { return stage.is_filter; });
+
+    // The value given to each stage is the value given to the stage before it, or the result of its map
+    function<void()> generate_value;
+    for (size_t i = 0; i < pipeline.stages.size(); i++)
+    {
+        const auto &stage = pipeline.stages[i];
+        if (i == 0)
+        {
+            write("for (");
+            generate_variable(stage.variable);
+            write(": gambit_source ) {");
+        }
+        else
+        {
+            generate_variable(stage.variable);
+            write("=");
+            generate_value();
             write(";");
-            break;
         }
 
-        default:
-            throw CompilerError("Could not generate C_Statement");
+        if (stage.is_filter && !is_branchless)
+        {
+            write("if ( ! (");
+            generate_expression(stage.body);
+            write(") ) continue ;");
         }
 
-        if (close_block_after.back() == i)
+        if (stage.is_filter)
+            generate_value = [&, variable = stage.variable]
+            { write(ir->variables.at(variable).identity); };
+        else
+            generate_value = [&, body = stage.body]
+            { generate_expression(body); };
+    }
+
+    if (is_branchless)
+    {
+        write("gambit_result += int32_t (");
+        for (size_t i = 0; i < pipeline.stages.size(); i++)
         {
-            close_block_after.pop_back();
-            write("}");
+            if (i > 0)
+                write("&&");
+            write("(");
+            generate_expression(pipeline.stages[i].body);
+            write(")");
         }
+        write(") ;");
+    }
+    else if (is_count)
+    {
+        write("gambit_result ++ ;");
+    }
+    else
+    {
+        write("gambit_result . push_back (");
+        generate_value();
+        write(") ;");
+    }
+
+    write("} return gambit_result ; } ( )");
+}
+
+void Generator::generate_arguments(const C_Expression &expr)
+{
+    write("(");
+    for (size_t i = 0; i < expr.argument_count; i++)
+    {
+        if (i > 0)
+            write(",");
+        generate_expression(ir->arguments[expr.first_argument + i]);
     }
+    write(")");
 }
 
 void Generator::generate_expression(size_t expression_index)
 {
-    auto &expr = ir.expressions.at(expression_index);
+    const auto &expr = ir->expressions.at(expression_index);
 
-    switch (expr.kind)
+    // Binary operators are always parenthesised, so that the precedence of the APM is preserved
+    auto generate_binary = [&](string_view op)
+    {
+        write("(");
+        generate_expression(expr.lhs);
+        write(op);
+        generate_expression(expr.rhs);
+        write(")");
+    };
+
+    auto argument = [&](size_t i)
     {
+        return ir->arguments[expr.first_argument + i];
+    };
 
-    case C_Expression::INVALID:
+    switch (expr.kind)
     {
-        // TODO: This should be an error
-        write("__NULL_EXPR__");
-        break;
-    }
+    case C_Expression::INVALID:
+        throw CompilerError("Attempt to generate Invalid C Expression");
 
     case C_Expression::DOUBLE_LITERAL:
-    {
-        write(to_string(expr.double_value));
+        write(expr.double_value);
         break;
-    }
+
     case C_Expression::INT_LITERAL:
-    {
-        write(to_string(expr.int_value));
+        write(expr.int_value);
         break;
-    }
+
     case C_Expression::BOOL_LITERAL:
-    {
         write(expr.bool_value ? "true" : "false");
         break;
-    }
+
     case C_Expression::STRING_LITERAL:
-    {
         // TODO: Use a dedicated string serialisation function, rather than using the JSON one
-        write(to_json(expr.string_value));
+        write(to_json(ir->string_literals.at(expr.string_index)));
+        break;
+
+    case C_Expression::ENUM_LITERAL:
+        write(ir->enums[ir->types[expr.type].index].values.at(expr.int_value - 1));
+        break;
+
+    case C_Expression::NONE_LITERAL:
+        generate_default_value(expr.type);
+        break;
+
+    case C_Expression::LIST_LITERAL:
+    {
+        generate_type(expr.type);
+        write("{");
+        for (size_t i = 0; i < expr.argument_count; i++)
+        {
+            if (i > 0)
+                write(",");
+            generate_expression(argument(i));
+        }
+        write("}");
         break;
     }
+
+    case C_Expression::STATIC_LIST:
+        write(ir->static_lists.at(expr.target).identity);
+        break;
+
+    case C_Expression::VARIABLE:
+        write(ir->variables.at(expr.variable).identity);
+        break;
+
+    case C_Expression::UNARY_NOT:
+        write("( !");
+        generate_expression(expr.lhs);
+        write(")");
+        break;
+
+    case C_Expression::UNARY_NEGATE:
+        write("( -");
+        generate_expression(expr.lhs);
+        write(")");
+        break;
+
+    case C_Expression::IS_SOME:
+        write("(");
+        generate_expression(expr.lhs);
+        write("!=");
+        generate_default_value(ir->expressions[expr.lhs].type);
+        write(")");
+        break;
+
     case C_Expression::BINARY_ADD:
-    {
+        generate_binary("+");
+        break;
+    case C_Expression::BINARY_SUB:
+        generate_binary("-");
+        break;
+    case C_Expression::BINARY_MUL:
+        generate_binary("*");
+        break;
+    case C_Expression::BINARY_DIV:
+        // Division always results in a `num`
+        write("( double (");
         generate_expression(expr.lhs);
-        write("+");
+        write(") /");
         generate_expression(expr.rhs);
+        write(")");
+        break;
+
+    case C_Expression::BINARY_EQUAL:
+    case C_Expression::BINARY_NOT_EQUAL:
+    {
+        // Strings are compared by value
+        if (ir->types[ir->expressions[expr.lhs].type].kind == C_Type::STRING)
+        {
+            write(expr.kind == C_Expression::BINARY_EQUAL ? "gambit::equal (" : "! gambit::equal (");
+            generate_expression(expr.lhs);
+            write(",");
+            generate_expression(expr.rhs);
+            write(")");
+        }
+        else
+        {
+            generate_binary(expr.kind == C_Expression::BINARY_EQUAL ? "==" : "!=");
+        }
         break;
     }
-    case C_Expression::BINARY_SUB:
+
+    case C_Expression::BINARY_LESS:
+        generate_binary("<");
+        break;
+    case C_Expression::BINARY_LESS_EQUAL:
+        generate_binary("<=");
+        break;
+    case C_Expression::BINARY_GREATER:
+        generate_binary(">");
+        break;
+    case C_Expression::BINARY_GREATER_EQUAL:
+        generate_binary(">=");
+        break;
+    case C_Expression::BINARY_AND:
+        generate_binary("&&");
+        break;
+    case C_Expression::BINARY_OR:
+        generate_binary("||");
+        break;
+
+    case C_Expression::CONDITIONAL:
     {
-        generate_expression(expr.lhs);
-        write("-");
-        generate_expression(expr.rhs);
+        // Lists of different capacities are converted to the type of the result, so that both results have the same type
+        auto generate_result = [&](size_t result)
+        {
+            if (ir->expressions[result].type == expr.type || ir->types[expr.type].kind != C_Type::LIST)
+            {
+                generate_expression(result);
+                return;
+            }
+            generate_type(expr.type);
+            write("(");
+            generate_expression(result);
+            write(")");
+        };
+
+        write("(");
+        generate_expression(argument(0));
+        write("?");
+        generate_result(argument(1));
+        write(":");
+        generate_result(argument(2));
+        write(")");
         break;
     }
-    case C_Expression::BINARY_MUL:
+
+    case C_Expression::NO_MATCH:
+        write("gambit::no_match <");
+        generate_type(expr.type);
+        write("> ( )");
+        break;
+
+    case C_Expression::ASSIGN:
     {
+        // State is assigned through the state block, as it may be packed
+        const auto &lhs = ir->expressions[expr.lhs];
+        if (lhs.kind == C_Expression::STATE_ACCESS)
+        {
+            generate_state_write(ir->state_properties.at(lhs.target), [&](size_t i)
+                                 { generate_expression(ir->arguments[lhs.first_argument + i]); },
+                                 expr.rhs);
+            break;
+        }
+
+        if (lhs.kind == C_Expression::LIST_INDEX && ir->expressions[lhs.lhs].kind == C_Expression::STATE_ACCESS)
+        {
+            generate_state_modification(ir->expressions[lhs.lhs], [&]
+                                        {
+                                            write("gambit::at ( list ,");
+                                            generate_expression(lhs.rhs);
+                                            write(") =");
+                                            generate_expression(expr.rhs); });
+            break;
+        }
+
         generate_expression(expr.lhs);
-        write("*");
+        write("=");
         generate_expression(expr.rhs);
         break;
     }
-    case C_Expression::BINARY_DIV:
-    {
+
+    // NOTE: Lists are indexed from 1
+    case C_Expression::LIST_INDEX:
+        write("gambit::at (");
         generate_expression(expr.lhs);
-        write("/");
+        write(",");
         generate_expression(expr.rhs);
+        write(")");
         break;
-    }
-    case C_Expression::BINARY_EQUAL:
-    {
+
+    case C_Expression::TABLE_LOOKUP:
+        write(ir->static_lists.at(expr.rhs).identity);
+        write("[");
         generate_expression(expr.lhs);
-        write("==");
+        write("]");
+        break;
+
+    case C_Expression::LIST_INSERT:
+        if (ir->expressions[expr.lhs].kind == C_Expression::STATE_ACCESS)
+        {
+            generate_state_modification(ir->expressions[expr.lhs], [&]
+                                        {
+                                            write("list . push_back (");
+                                            generate_expression(expr.rhs);
+                                            write(")"); });
+            break;
+        }
+
+        generate_expression(expr.lhs);
+        write(". push_back (");
         generate_expression(expr.rhs);
+        write(")");
+        break;
+
+    case C_Expression::LIST_SHUFFLE:
+        if (ir->expressions[expr.lhs].kind == C_Expression::STATE_ACCESS)
+        {
+            generate_state_modification(ir->expressions[expr.lhs], [&]
+                                        { write("gambit::shuffle ( list )"); });
+            break;
+        }
+
+        write("gambit::shuffle (");
+        generate_expression(expr.lhs);
+        write(")");
+        break;
+
+    case C_Expression::LIST_COUNT:
+        write("int32_t (");
+        generate_expression(expr.lhs);
+        write(". size ( ) )");
+        break;
+
+    case C_Expression::LIST_PIPELINE:
+        generate_pipeline(expr);
+        break;
+
+    case C_Expression::STATE_ACCESS:
+        generate_state_read(ir->state_properties.at(expr.target), [&](size_t i)
+                            { generate_expression(argument(i)); });
+        break;
+
+    case C_Expression::ENTITY_SELECT:
+    {
+        const auto &state = ir->state_properties.at(expr.target);
+        if (state.reverse_index.empty())
+        {
+            write("gambit::first_where ( gambit_state .");
+            write(ir->entities[state.entity].storage);
+            write(". count , [ & , gambit_value =");
+            generate_type(state.type);
+            write("(");
+            generate_expression(argument(0));
+            write(") ] ( uint32_t gambit_entity ) { return gambit::equal (");
+            generate_state_read(state, [&](size_t)
+                                { write("gambit_entity"); });
+            write(", gambit_value ) ; } )");
+            break;
+        }
+
+        write("gambit_state .");
+        write(ir->entities[state.entity].storage);
+        write(".");
+        write(state.reverse_index);
+        write(". first ( size_t (");
+        generate_expression(argument(0));
+        write(") )");
         break;
     }
-    case C_Expression::BINARY_AND:
+
+    case C_Expression::ENTITY_SCAN:
     {
-        generate_expression(expr.lhs);
-        write("&&");
-        generate_expression(expr.rhs);
+        const auto &funct = ir->functions.at(expr.target);
+        write("gambit::first_where ( gambit_state .");
+        write(ir->entities[ir->types[expr.type].index].storage);
+        write(". count , [ & , gambit_value =");
+        generate_type(funct.return_type);
+        write("(");
+        generate_expression(argument(0));
+        write(") ] ( uint32_t gambit_entity ) { return gambit::equal (");
+        write(funct.identity);
+        write("( gambit_entity ) , gambit_value ) ; } )");
         break;
     }
-    case C_Expression::BINARY_OR:
+
+    case C_Expression::FUNCTION_CALL:
+        write(ir->functions.at(expr.target).identity);
+        generate_arguments(expr);
+        break;
+
+    case C_Expression::ENTITY_CREATE:
+        write(ir->entities[ir->types[expr.type].index].create_function);
+        write("( )");
+        break;
+
+    case C_Expression::CHOOSE:
     {
-        generate_expression(expr.lhs);
-        write("||");
-        generate_expression(expr.rhs);
+        // `choose[k]` has the type of a list of the choices, rather than the type of a choice
+        size_t value_type = ir->types[ir->expressions[argument(2)].type].index;
+        if (expr.type != value_type)
+        {
+            write("gambit::choose_combination <");
+            write((int)ir->types[expr.type].capacity);
+            write(">");
+        }
+        else
+        {
+            write("gambit::choose");
+        }
+
+        // Choices are described to the player with the name of the enum value or entity
+        const auto &type = ir->types[value_type];
+        write("(");
+        generate_expression(argument(0));
+        write(",");
+        generate_expression(argument(1));
+        write(",");
+        generate_expression(argument(2));
+        write(", [ ] (");
+        generate_type(value_type);
+        write("value ) { return");
+        if (type.kind == C_Type::ENUM)
+        {
+            write("std::string (");
+            write(ir->enums[type.index].names_identity);
+            write("[ value ] )");
+        }
+        else if (type.kind == C_Type::ENTITY)
+        {
+            write(to_json(ir->entities[type.index].name + " "));
+            write("+ std::to_string ( value )");
+        }
+        else
+        {
+            write("gambit::describe ( value )");
+        }
+        write("; } )");
         break;
     }
 
     default:
         throw CompilerError("Could not generate C_Expression " + to_string(expr.kind));
     }
-}
\ No newline at end of file
+}
@@ -3,25 +3,73 @@
 #define GENERATOR_H
 
 #include "ir.h"
+#include <functional>
+#include <ostream>
 #include <string>
+#include <string_view>
 using namespace std;
 
 class Generator
 {
 public:
-    string generate(C_Program representation);
+    // Writes the C++ source code for the program to `output`, returning the number of characters written
+    size_t generate(const C_Program &representation, ostream &output);
 
 private:
-    string source;
-    C_Program ir;
+    // NOTE: Tokens are collected in a fixed-capacity buffer which is flushed to the output stream
+    //       whenever it fills up, so that generating a large program never builds the whole source
+    //       in memory or allocates per token.
+    static constexpr size_t buffer_capacity = 64 * 1024;
 
-    void write(string token);
+    string buffer;
+    ostream *output = nullptr;
+    size_t characters_written = 0;
 
-    void generate_program(C_Program program);
-    void generate_function_signature(C_Function funct);
-    void generate_function_declaration(C_Function funct);
+    // The IR is only borrowed for the duration of `generate`
+    const C_Program *ir = nullptr;
 
+    void write(string_view token);
+    void write(int value);
+    void write(double value);
+    void flush();
+
+    void generate_program(const C_Program &program);
+
+    // Types and storage
+    void generate_type(size_t type);
+    void generate_state_type(size_t type);
+    void generate_default_value(size_t type);
+    void generate_enum(const C_Enum &c_enum);
+
+    // State
+    size_t table_dimension(size_t parameter);
+    void generate_state_declaration(const C_StateProperty &state, size_t length);
+    void generate_entity_storage(size_t entity);
+    void generate_table(const C_StateProperty &state);
+    bool generate_arena();
+    void generate_state_index(const C_StateProperty &state, const function<void(size_t)> &generate_argument);
+    void generate_flat_index(const vector<size_t> &parameters, const function<void(size_t)> &generate_argument);
+    void generate_state_reference(const C_StateProperty &state);
+    void generate_state_read(const C_StateProperty &state, const function<void(size_t)> &generate_argument);
+    void generate_state_write(const C_StateProperty &state, const function<void(size_t)> &generate_argument, size_t value);
+    void generate_state_write(const C_StateProperty &state, const function<void(size_t)> &generate_argument, const function<void()> &generate_value);
+    void generate_state_modification(const C_Expression &access, const function<void()> &generate_modification);
+    size_t state_key(const C_StateProperty &state);
+    size_t entity_key(size_t entity);
+    void generate_create_function(size_t entity);
+    void generate_setup_function();
+    bool generate_determinise_function();
+
+    // Functions
+    void generate_variable(size_t variable);
+    void generate_function_signature(const C_Function &funct);
+    void generate_function_declaration(const C_Function &funct);
+
+    // Statements and expressions
+    size_t generate_statement(size_t statement_index);
     void generate_expression(size_t expression_index);
+    void generate_arguments(const C_Expression &expr);
+    void generate_pipeline(const C_Expression &expr);
 };
 
 #endif
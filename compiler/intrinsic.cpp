@@ -44,4 +44,14 @@ namespace Intrinsic
         {ptr<Variable>(new Variable({Span(), "game", entity_game}))}, // parameters
         {}                                                            // initial_value
     }));
+
+    // NOTE: Shuffles a list in place, using the game's own randomness. The body is empty, as calls to
+    //       it are converted directly rather than to a call to a function.
+    ptr<Procedure> procedure_shuffle = ptr<Procedure>(new Procedure({
+        Span(),                                                                                                   // span
+        "shuffle",                                                                                                // identity
+        CREATE(Scope),                                                                                            // scope
+        {ptr<Variable>(new Variable({Span(), "list", ptr<ListType>(new ListType({CREATE(AnyPattern), {}}))}))}, // parameters
+        ptr<CodeBlock>(new CodeBlock({Span(), false, CREATE(Scope), {}}))                                        // body
+    }));
 }
\ No newline at end of file
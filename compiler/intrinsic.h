@@ -23,6 +23,8 @@ namespace Intrinsic
     extern ptr<EntityType> entity_game;
     extern ptr<Variable> variable_game;
     extern ptr<StateProperty> state_game_players;
+
+    extern ptr<Procedure> procedure_shuffle;
 }
 
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@ then from the IR to source code.
 #ifndef IR_H
 #define IR_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -18,7 +19,17 @@ using namespace std;
 
 // Program
 struct C_Program;
+struct C_Intrinsics;
 struct C_Function;
+struct C_Variable;
+
+// Types and storage
+struct C_Type;
+struct C_Enum;
+struct C_Entity;
+struct C_StateProperty;
+struct C_StaticList;
+struct C_Pipeline;
 
 // Statements
 struct C_Statement;
@@ -26,19 +37,214 @@ struct C_Statement;
 // Expressions
 struct C_Expression;
 
+// Used in place of an index when there is nothing to refer to
+constexpr size_t C_NO_INDEX = SIZE_MAX;
+
 // PROGRAM
 
+// NOTE: Nodes refer to each other by their index in the vectors of the C_Program.
+struct C_Intrinsics
+{
+    size_t player_count = 2;
+
+    size_t player_entity = C_NO_INDEX;
+    size_t game_entity = C_NO_INDEX;
+    size_t game_variable = C_NO_INDEX;
+    size_t main_function = C_NO_INDEX;
+    size_t evaluation_function = C_NO_INDEX; // `(Player p).evaluation`, for searches that stop before the end of the game
+};
+
 struct C_Program
 {
+    vector<C_Type> types;
+    vector<C_Enum> enums;
+    vector<C_Entity> entities;
+    vector<C_StateProperty> state_properties;
+    vector<C_StaticList> static_lists;
+    vector<C_Pipeline> pipelines;
+
     vector<C_Function> functions;
+    vector<C_Variable> variables;
     vector<C_Statement> statements;
     vector<C_Expression> expressions;
+
+    // The arguments of calls, property accesses, and list literals are stored
+    // contiguously, and referred to by the index of the first argument.
+    vector<size_t> arguments;
+
+    // Each distinct string literal is stored once, and referred to by its index
+    vector<string> string_literals;
+
+    C_Intrinsics intrinsics;
 };
 
 struct C_Function
 {
     string identity;
+    size_t return_type;
+    vector<size_t> parameters; // C_Variables
     size_t body;
+
+    // Memoised functions cache their result for each combination of arguments, until one of the
+    // state properties they read is written to
+    bool memoised = false;
+    string cache_identity;
+    vector<size_t> reads; // C_StateProperties
+};
+
+struct C_Variable
+{
+    string identity;
+    size_t type;
+
+    // Variables that refer to a list without copying it, as they are never written to
+    bool is_reference = false;
+};
+
+// TYPES AND STORAGE
+
+struct C_Type
+{
+    enum Kind
+    {
+        VOID,
+        BOOL,
+        INT,
+        DOUBLE,
+        STRING,
+        ENUM,
+        ENTITY,
+        LIST
+    };
+
+    Kind kind = VOID;
+    bool optional = false;
+
+    // The C_Enum or C_Entity of the type, or the C_Type of the elements of a list
+    size_t index = 0;
+
+    // The number of elements of a fixed size list, otherwise 0
+    size_t fixed_size = 0;
+
+    // The greatest number of elements of a list without a fixed size, when it is known, otherwise 0.
+    // Lists with a capacity are stored inline rather than being allocated.
+    size_t capacity = 0;
+
+    bool operator==(const C_Type &other) const
+    {
+        return kind == other.kind &&
+               optional == other.optional &&
+               index == other.index &&
+               fixed_size == other.fixed_size &&
+               capacity == other.capacity;
+    }
+};
+
+// NOTE: Enum values are numbered from 1, so that 0 can be used to represent `none`.
+struct C_Enum
+{
+    string identity;
+    string names_identity; // Table of the names of the values, used when presenting choices
+    vector<string> values;
+    vector<string> names;
+};
+
+// NOTE: Entities are identified by an id that is an index into the storage of their type.
+//       Ids are numbered from 1, so that 0 can be used to represent `none`.
+struct C_Entity
+{
+    string identity;
+    string name;
+    string storage;
+    string create_function;
+
+    // The greatest number of entities of this type that can exist at once. Determined
+    // by the converter from where in the program entities are created.
+    size_t capacity;
+    bool capacity_determined = true; // False if the capacity is the default, as it could not be determined
+};
+
+// NOTE: State properties are stored as struct-of-arrays. A property of a single entity is
+//       a column in the storage of that entity type, so that reading it is an indexed load.
+//       Properties with any other parameters are stored as a dense table, indexed by each
+//       of the parameters. All columns and tables are kept in one contiguous state block.
+//       Lists of a fixed size are stored inline, and other lists in an arena in the block.
+//       Tables that would be large, and that have a constant initial value, are stored sparsely
+//       in the arena, with only the entries that are not the initial value.
+struct C_StateProperty
+{
+    enum Storage
+    {
+        ENTITY_COLUMN,
+        TABLE,
+        SPARSE_TABLE
+    };
+
+    string identity;
+    size_t type;
+    vector<size_t> parameters; // C_Variables
+
+    Storage storage;
+    size_t entity; // The entity type that owns an ENTITY_COLUMN
+
+    // Evaluated when an entity (or, for tables, the game) is created
+    size_t initial_value;
+
+    // The number of bits each value is packed into, or 0 if values are stored unpacked
+    size_t packed_bits = 0;
+
+    // The number of entries a SPARSE_TABLE has room for before it first grows, which is a power of two
+    size_t sparse_capacity = 0;
+
+    // Lists without a fixed size are kept in an arena in the state block. This is the number of
+    // elements each list is expected to hold, which the arena is sized for, or 0 for other types.
+    size_t list_capacity = 0;
+
+    // Columns that entities are selected by have a reverse index, from each of their values to the
+    // entities with that value. This is the identity of the index, or empty if there is none.
+    string reverse_index;
+    size_t reverse_index_values = 0; // The number of distinct values, including `none`
+
+    // Hidden state is only seen by the player that owns it, or by no one if it is not owned by a
+    // player. A search that plays as a player samples the values it cannot see.
+    bool hidden = false;
+};
+
+// NOTE: Lists whose values are all known at compile time are built once, as read-only tables
+//       outside of the state, and are referred to by STATIC_LIST expressions.
+struct C_StaticList
+{
+    string identity;
+    size_t type;
+    size_t value; // The LIST_LITERAL that initialises the table
+
+    // Lookup tables are plain arrays indexed directly by an enum value, including `none` at index 0
+    bool is_lookup_table = false;
+};
+
+// NOTE: A chain of list operations, such as `xs filter (x: ...) map (x: ...)`, is fused into a
+//       single loop over the source list, so that the intermediate lists are never built. Each stage
+//       binds its variable to the value it is given. A filter passes the value on when its body is
+//       true, and a map passes on the value of its body. The values that reach the end are either
+//       collected into a list, or counted.
+struct C_Pipeline
+{
+    enum Sink
+    {
+        COLLECT,
+        COUNT
+    };
+
+    struct Stage
+    {
+        bool is_filter;
+        size_t variable;
+        size_t body;
+    };
+
+    size_t source; // The list expression that is looped over
+    vector<Stage> stages;
+    Sink sink = COLLECT;
 };
 
 // STATEMENTS
@@ -56,6 +262,8 @@ struct C_Statement
         WHILE_LOOP,
         RETURN_STATEMENT,
         VARIABLE_DECLARATION,
+        WINS_STATEMENT,
+        DRAW_STATEMENT,
 
         CODE_BLOCK,
         EXPRESSION_STATEMENT
@@ -71,6 +279,7 @@ struct C_Statement
         struct
         {
             size_t expression;
+            size_t variable; // The variable of a declaration or for loop
         };
     };
 };
@@ -87,17 +296,53 @@ struct C_Expression
         INT_LITERAL,
         BOOL_LITERAL,
         STRING_LITERAL,
+        ENUM_LITERAL,
+        NONE_LITERAL,
+        LIST_LITERAL,
+        STATIC_LIST,
+
+        VARIABLE,
+
+        UNARY_NOT,
+        UNARY_NEGATE,
+        IS_SOME,
 
         BINARY_ADD,
         BINARY_SUB,
         BINARY_MUL,
         BINARY_DIV,
         BINARY_EQUAL,
+        BINARY_NOT_EQUAL,
+        BINARY_LESS,
+        BINARY_LESS_EQUAL,
+        BINARY_GREATER,
+        BINARY_GREATER_EQUAL,
         BINARY_AND,
         BINARY_OR,
+
+        CONDITIONAL,
+        NO_MATCH,
+        ASSIGN,
+
+        LIST_INDEX,
+        LIST_INSERT,
+        LIST_SHUFFLE,  // The lhs is the list, which is shuffled in place
+        LIST_COUNT,    // The lhs is the list
+        LIST_PIPELINE, // The target is the C_Pipeline
+        TABLE_LOOKUP, // The lhs is the enum value and the rhs is the C_StaticList
+
+        STATE_ACCESS,
+        ENTITY_SELECT, // The target is the state property, and the argument is the value to select by. Searches the column if it has no reverse index.
+        ENTITY_SCAN,   // The target is the function, and the argument is the value to select by
+        FUNCTION_CALL,
+        ENTITY_CREATE,
+
+        CHOOSE, // The type is a list with a capacity when several values are chosen at once
     };
 
     Kind kind;
+    uint32_t type; // The C_Type of the value of the expression
+
     union
     {
         struct
@@ -111,15 +356,33 @@ struct C_Expression
         };
         struct
         {
-            int int_value;
+            int int_value; // Also the value of an ENUM_LITERAL
         };
         struct
         {
             bool bool_value;
         };
+        struct
+        {
+            size_t string_index; // Index into C_Program::string_literals
+        };
+        struct
+        {
+            size_t variable;
+        };
+        struct
+        {
+            // The state property or function of an access or call, or the C_StaticList of a
+            // STATIC_LIST. The arguments of a CONDITIONAL are its condition and results, and
+            // of a CHOOSE are its player, prompt and choices.
+            uint32_t target;
+            uint32_t first_argument;
+            uint32_t argument_count;
+        };
     };
-
-    string string_value; // TODO: Ideally this would go in the union, but that takes some effort to do!
 };
 
-#endif
\ No newline at end of file
+// NOTE: Expressions are stored contiguously and walked by the generator, so keep them small.
+static_assert(sizeof(C_Expression) <= 24, "C_Expression should fit in 24 bytes");
+
+#endif
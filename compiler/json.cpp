@@ -10,6 +10,11 @@ string to_json(const int &value, const size_t &depth)
     return to_string(value);
 }
 
+string to_json(const size_t &value, const size_t &depth)
+{
+    return to_string(value);
+}
+
 string to_json(const double &value, const size_t &depth)
 {
     return to_string(value);
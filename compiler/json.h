@@ -26,6 +26,7 @@ class JsonContainer;
 
 string to_json(const JsonContainer &value, const size_t &depth = 0);
 string to_json(const int &value, const size_t &depth = 0);
+string to_json(const size_t &value, const size_t &depth = 0);
 string to_json(const double &value, const size_t &depth = 0);
 string to_json(const bool &value, const size_t &depth = 0);
 string to_json(const monostate &value, const size_t &depth = 0);
@@ -2,17 +2,21 @@
 #include "checker.h"
 #include "converter.h"
 #include "errors.h"
+#include "evaluator.h"
 #include "generator.h"
 #include "json.h"
 #include "lexer.h"
 #include "parser.h"
 #include "resolver.h"
 #include "source.h"
+#include "stats.h"
 #include "token.h"
+#include "trace.h"
 #include "utilty.h"
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
 using namespace std;
 
@@ -34,21 +38,61 @@ void output_program(ptr<Program> program, string file_name)
     }
 }
 
-// Output to C
+// Output to C++
 
-void output_c_source(string source, string file_name)
+void output_cpp_source(const C_Program &representation, string file_name)
 {
     std::ofstream output;
-    output.open("local/" + file_name + ".c");
+    output.open("local/" + file_name + ".cpp");
     if (output.is_open())
     {
-        output << source;
-        cout << "Saved C source code to local/" + file_name + ".c" << endl;
+        Generator generator;
+        generator.generate(representation, output);
+        cout << "Saved C++ source code to local/" + file_name + ".cpp" << endl;
         output.close();
     }
     else
     {
-        cout << "Error attempting to save C source code to local/" + file_name + ".c" << endl;
+        cout << "Error attempting to save C++ source code to local/" + file_name + ".cpp" << endl;
+    }
+}
+
+// Output stats
+
+void output_stats(const CompilerStats &stats)
+{
+    cout << "\nSTATS" << endl;
+    cout << stats.to_text();
+
+    std::ofstream output;
+    output.open("local/stats.json");
+    if (output.is_open())
+    {
+        output << stats.to_json();
+        cout << "\nSaved stats to local/stats.json" << endl;
+        output.close();
+    }
+    else
+    {
+        cout << "\nError attempting to save stats to local/stats.json" << endl;
+    }
+}
+
+// Output trace
+
+void output_trace()
+{
+    std::ofstream output;
+    output.open("local/trace.json");
+    if (output.is_open())
+    {
+        output << Trace::to_json();
+        cout << "\nSaved trace to local/trace.json" << endl;
+        output.close();
+    }
+    else
+    {
+        cout << "\nError attempting to save trace to local/trace.json" << endl;
     }
 }
 
@@ -57,21 +101,55 @@ void output_c_source(string source, string file_name)
 int main(int argc, char *argv[])
 {
     // FIXME: Allow for compilation of multiple source files.
+    optional<string> program_path;
+    bool stats_enabled = false;
+    optional<size_t> entity_capacity;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--stats")
+        {
+            stats_enabled = true;
+        }
+        else if (arg == "--trace")
+        {
+            Trace::enabled = true;
+        }
+        else if (arg == "--entity-capacity" && i + 1 < argc && string(argv[i + 1]).find_first_not_of("0123456789") == string::npos)
+        {
+            entity_capacity = stoul(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            cout << "Unrecognised argument " << arg << endl;
+            cout << "USAGE: gambit [--stats] [--trace] [--entity-capacity N] <program>" << endl;
+            return 1;
+        }
+        else
+        {
+            program_path = arg;
+        }
+    }
 
     // FIXME: Remove this default value! I only have it for now for ease of testing
-    string source_path = (argc == 2)
-                             ? (string)argv[1] + ".gambit"
+    string source_path = program_path.has_value()
+                             ? program_path.value() + ".gambit"
                              : "local/main.gambit";
 
     Source source(source_path);
 
     ptr<Program> program = nullptr;
+    CompilerStats stats(stats_enabled);
 
     try
     {
         cout << "\nLEXING" << endl;
+        stats.start_phase("lexer");
         Lexer lexer;
         lexer.tokenise(source);
+        stats.finish_phase();
+        stats.record_tokens(source);
 
         // for (auto t : tokens)
         //     cout << to_string(t) << endl;
@@ -82,18 +160,27 @@ int main(int argc, char *argv[])
         // cout << endl;
 
         cout << "\nPARSING" << endl;
+        stats.start_phase("parser");
         Parser parser;
         program = parser.parse(source);
+        stats.finish_phase();
+        stats.record_apm(program);
         output_program(program, "parser_output");
 
         cout << "\nRESOLVER" << endl;
+        stats.start_phase("resolver");
         Resolver resolver;
         resolver.resolve(source, program);
+        stats.finish_phase();
+        stats.record_apm(program);
         output_program(program, "resolver_output");
 
         cout << "\nCHECKER" << endl;
+        stats.start_phase("checker");
         Checker checker;
         checker.check(source, program);
+        stats.finish_phase();
+        stats.record_apm(program);
         output_program(program, "checker_output");
 
         if (source.errors.size() > 0)
@@ -105,15 +192,34 @@ int main(int argc, char *argv[])
         }
         else
         {
+            cout << "\nEVALUATOR" << endl;
+            stats.start_phase("evaluator");
+            Evaluator evaluator;
+            evaluator.evaluate(program);
+            stats.finish_phase();
+            stats.record_apm(program);
+            output_program(program, "evaluator_output");
+
             cout << "\nCONVERTER" << endl;
+            stats.start_phase("converter");
             Converter converter;
+            if (entity_capacity.has_value())
+                converter.default_entity_capacity = entity_capacity.value();
             auto representation = converter.convert(program);
+            stats.finish_phase();
+
+            if (converter.notes.size() > 0)
+            {
+                cout << "\nNOTES" << endl;
+                for (const auto &note : converter.notes)
+                    cout << note << endl;
+            }
             // TODO: Output as JSON
 
             cout << "\nGENERATOR" << endl;
-            Generator generator;
-            auto source = generator.generate(representation);
-            output_c_source(source, "generated");
+            stats.start_phase("generator");
+            output_cpp_source(representation, "generated");
+            stats.finish_phase();
         }
 
         cout << "Compilation complete" << endl;
@@ -125,5 +231,11 @@ int main(int argc, char *argv[])
         cout << error.what() << endl;
     }
 
+    if (stats.enabled)
+        output_stats(stats);
+
+    if (Trace::enabled)
+        output_trace();
+
     return 0;
 }
\ No newline at end of file
@@ -2,9 +2,11 @@
 #include "source.h"
 #include "intrinsic.h"
 #include "parser.h"
+#include "trace.h"
 
 ptr<Program> Parser::parse(Source &source)
 {
+    TraceScope trace("Parser::parse");
     this->source = &source;
     current_token_index = 0;
     current_block_nesting = 0;
@@ -326,6 +328,8 @@ void Parser::parse_program()
     declare(program->global_scope, Intrinsic::variable_game);
     declare(program->global_scope, Intrinsic::state_game_players);
 
+    declare(program->global_scope, Intrinsic::procedure_shuffle);
+
     while (!peek_and_consume(Token::EndOfFile))
     {
         if (peek_entity_definition())
@@ -496,7 +500,7 @@ void Parser::parse_entity_definition(ptr<Scope> scope)
 
 bool Parser::peek_state_property_definition()
 {
-    return peek(Token::KeyState);
+    return peek(Token::KeyState) || peek(Token::KeyHidden);
 }
 
 void Parser::parse_state_property_definition(ptr<Scope> scope)
@@ -506,6 +510,7 @@ void Parser::parse_state_property_definition(ptr<Scope> scope)
     state->scope->parent = scope;
 
     start_span();
+    state->hidden = peek_and_consume(Token::KeyHidden);
     confirm_and_consume(Token::KeyState);
 
     state->pattern = parse_literal(false);
@@ -997,6 +1002,8 @@ Expression Parser::parse_expression(Precedence caller_precedence)
             lhs = parse_infix_logical_or(lhs);
         else if (peek_infix_choose() && operator_should_bind(Precedence::Choose, caller_precedence))
             lhs = parse_infix_choose(lhs);
+        else if (peek_infix_list_operation() && operator_should_bind(Precedence::ListOperation, caller_precedence))
+            lhs = parse_infix_list_operation(lhs);
         else
             break;
     }
@@ -1141,7 +1148,8 @@ bool Parser::peek_unary()
 {
     return peek(Token::Add) ||
            peek(Token::Sub) ||
-           peek(Token::KeyNot);
+           peek(Token::KeyNot) ||
+           peek(Token::Hash);
 }
 
 ptr<Unary> Parser::parse_unary()
@@ -1157,6 +1165,8 @@ ptr<Unary> Parser::parse_unary()
         op_token = consume(Token::Sub);
     else if (peek(Token::KeyNot))
         op_token = consume(Token::KeyNot);
+    else if (peek(Token::Hash))
+        op_token = consume(Token::Hash);
     else
         throw CompilerError("Expected unary expression, got " + to_string(current_token()) + " token");
 
@@ -1182,6 +1192,13 @@ ptr<ChooseExpression> Parser::parse_infix_choose(Expression lhs)
 
     expr->player = lhs;
 
+    // `choose[k]` chooses k different values at once
+    if (peek_and_consume(Token::SquareL))
+    {
+        expr->count = parse_expression();
+        consume(Token::SquareR);
+    }
+
     consume(Token::ParenL);
     expr->prompt = parse_expression();
     consume(Token::ParenR);
@@ -1192,6 +1209,47 @@ ptr<ChooseExpression> Parser::parse_infix_choose(Expression lhs)
     return expr;
 }
 
+bool Parser::peek_infix_list_operation()
+{
+    return peek(Token::KeyFilter) || peek(Token::KeyMap);
+}
+
+ptr<ListOperation> Parser::parse_infix_list_operation(Expression lhs)
+{
+    auto list_operation = CREATE(ListOperation);
+    list_operation->list = lhs;
+
+    if (peek_and_consume(Token::KeyFilter))
+        list_operation->op = "filter";
+    else if (peek_and_consume(Token::KeyMap))
+        list_operation->op = "map";
+    else
+        throw CompilerError("Expected list operation, got " + to_string(current_token()) + " token");
+
+    // The variable is declared in a scope of its own, which the resolver attaches to the enclosing scope
+    list_operation->scope = CREATE(Scope);
+
+    start_span();
+    confirm_and_consume(Token::ParenL);
+
+    start_span();
+    auto variable = CREATE(Variable);
+    variable->identity = consume(Token::Identity).str;
+    variable->is_constant = true;
+    variable->pattern = CREATE(UninferredPattern);
+    variable->span = finish_span();
+
+    list_operation->variable = variable;
+    declare(list_operation->scope, variable);
+
+    confirm_and_consume(Token::Colon);
+    list_operation->body = parse_expression();
+    confirm_and_consume(Token::ParenR);
+
+    list_operation->span = merge(get_span(lhs), finish_span());
+    return list_operation;
+}
+
 bool Parser::peek_infix_logical_or()
 {
     return peek(Token::KeyOr);
@@ -1331,8 +1389,20 @@ bool Parser::peek_infix_index_with_expression()
     return peek(Token::SquareL);
 }
 
-ptr<IndexWithExpression> Parser::parse_infix_index_with_expression(Expression lhs)
+Expression Parser::parse_infix_index_with_expression(Expression lhs)
 {
+    // Entity selectors, such as `Player[mark: X]`, name a property before the colon
+    if (peek_next(Token::Identity))
+    {
+        size_t index = current_token_index;
+        consume(Token::SquareL);
+        bool is_entity_selector = peek(Token::Identity) && peek_next(Token::Colon);
+        current_token_index = index;
+
+        if (is_entity_selector)
+            return parse_entity_selector(lhs);
+    }
+
     auto index_with_expression = CREATE(IndexWithExpression);
     index_with_expression->subject = lhs;
 
@@ -1352,6 +1422,28 @@ ptr<IndexWithExpression> Parser::parse_infix_index_with_expression(Expression lh
     return index_with_expression;
 }
 
+ptr<EntitySelector> Parser::parse_entity_selector(Expression lhs)
+{
+    auto entity_selector = CREATE(EntitySelector);
+    entity_selector->subject = lhs;
+
+    consume(Token::SquareL);
+
+    auto token = consume(Token::Identity);
+    auto identity_literal = CREATE(IdentityLiteral);
+    identity_literal->identity = token.str;
+    identity_literal->span = to_span(token);
+    entity_selector->property = identity_literal;
+
+    consume(Token::Colon);
+    entity_selector->value = parse_expression();
+
+    start_span();
+    confirm_and_consume(Token::SquareR);
+    entity_selector->span = merge(get_span(lhs), finish_span());
+    return entity_selector;
+}
+
 bool Parser::peek_infix_index_with_identity()
 {
     return peek(Token::Dot);
@@ -1510,7 +1602,8 @@ UnresolvedLiteral Parser::parse_literal(bool allow_primitive_values)
 
         else if (token.kind == Token::String)
         {
-            primitive_value->value = token.str;
+            // The string token includes its quotes
+            primitive_value->value = token.str.substr(1, token.str.size() - 2);
             primitive_value->type = Intrinsic::type_str;
         }
 
@@ -106,6 +106,8 @@ private:
 
     bool peek_infix_choose();
     [[nodiscard]] ptr<ChooseExpression> parse_infix_choose(Expression lhs);
+    bool peek_infix_list_operation();
+    [[nodiscard]] ptr<ListOperation> parse_infix_list_operation(Expression lhs);
     bool peek_infix_logical_or();
     [[nodiscard]] ptr<Binary> parse_infix_logical_or(Expression lhs);
     bool peek_infix_logical_and();
@@ -119,7 +121,8 @@ private:
     bool peek_infix_factor();
     [[nodiscard]] ptr<Binary> parse_infix_factor(Expression lhs);
     bool peek_infix_index_with_expression();
-    [[nodiscard]] ptr<IndexWithExpression> parse_infix_index_with_expression(Expression lhs);
+    [[nodiscard]] Expression parse_infix_index_with_expression(Expression lhs);
+    [[nodiscard]] ptr<EntitySelector> parse_entity_selector(Expression lhs);
     bool peek_infix_index_with_identity();
     [[nodiscard]] ptr<IndexWithIdentity> parse_infix_index_with_identity(Expression lhs);
     bool peek_infix_call();
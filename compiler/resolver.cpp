@@ -2,10 +2,12 @@
 #include "intrinsic.h"
 #include "resolver.h"
 #include "source.h"
+#include "trace.h"
 #include <optional>
 
 void Resolver::resolve(Source &source, ptr<Program> program)
 {
+    TraceScope trace("Resolver::resolve");
     this->source = &source;
     resolve_program(program);
 }
@@ -40,6 +42,7 @@ void Resolver::resolve_scope(ptr<Scope> scope)
 
 void Resolver::resolve_scope_lookup_value_property_signatures_pass(Scope::LookupValue value, ptr<Scope> scope)
 {
+    TraceScope trace("Resolver::resolve_scope_lookup_value_property_signatures_pass", value);
     if (IS_PTR(value, StateProperty))
     {
         auto state = AS_PTR(value, StateProperty);
@@ -64,6 +67,7 @@ void Resolver::resolve_scope_lookup_value_property_signatures_pass(Scope::Lookup
 
 void Resolver::resolve_scope_lookup_value_final_pass(Scope::LookupValue value, ptr<Scope> scope)
 {
+    TraceScope trace("Resolver::resolve_scope_lookup_value_final_pass", value);
     if (IS_PTR(value, Variable))
     {
         auto variable = AS_PTR(value, Variable);
@@ -249,6 +253,12 @@ Expression Resolver::resolve_expression(Expression expression, ptr<Scope> scope,
     else if (IS_PTR(expression, IndexWithIdentity))
         return resolve_index_with_identity(AS_PTR(expression, IndexWithIdentity), scope, pattern_hint);
 
+    else if (IS_PTR(expression, EntitySelector))
+        resolve_entity_selector(AS_PTR(expression, EntitySelector), scope, pattern_hint);
+
+    else if (IS_PTR(expression, ListOperation))
+        resolve_list_operation(AS_PTR(expression, ListOperation), scope, pattern_hint);
+
     else if (IS_PTR(expression, Call))
         resolve_call(AS_PTR(expression, Call), scope, pattern_hint);
 
@@ -364,6 +374,12 @@ void Resolver::resolve_instance_list(ptr<InstanceList> list, ptr<Scope> scope, o
 void Resolver::resolve_call(ptr<Call> call, ptr<Scope> scope, optional<Pattern> pattern_hint)
 {
     // TODO: Resolve callee
+    if (IS(call->callee, UnresolvedLiteral) && IS_PTR(AS(call->callee, UnresolvedLiteral), IdentityLiteral))
+    {
+        auto callee_identity = AS_PTR(AS(call->callee, UnresolvedLiteral), IdentityLiteral)->identity;
+        if (callee_identity == Intrinsic::procedure_shuffle->identity)
+            call->procedure = Intrinsic::procedure_shuffle;
+    }
 
     for (size_t i = 0; i < call->arguments.size(); i++)
     {
@@ -377,6 +393,8 @@ void Resolver::resolve_choose_expression(ptr<ChooseExpression> choose_expression
     choose_expression->choices = resolve_expression(choose_expression->choices, scope, {}); // FIXME: Should there be a pattern hint here?
     choose_expression->player = resolve_expression(choose_expression->player, scope, Intrinsic::entity_player);
     choose_expression->prompt = resolve_expression(choose_expression->prompt, scope, Intrinsic::type_str);
+    if (choose_expression->count.has_value())
+        choose_expression->count = resolve_expression(choose_expression->count.value(), scope, Intrinsic::type_amt);
 }
 
 void Resolver::resolve_if_expression(ptr<IfExpression> if_expression, ptr<Scope> scope, optional<Pattern> pattern_hint)
@@ -456,6 +474,7 @@ Expression Resolver::resolve_index_with_identity(ptr<IndexWithIdentity> index_wi
 
     // PropertyAccess
     auto property_access = CREATE(PropertyAccess);
+    property_access->span = index_with_identity->span;
     auto subject = resolve_expression(index_with_identity->subject, scope);
     property_access->subject = subject;
 
@@ -507,6 +526,88 @@ Expression Resolver::resolve_index_with_identity(ptr<IndexWithIdentity> index_wi
     return property_access;
 }
 
+// NOTE: As with property indexes, the property of an entity selector must be the only overload
+//       that applies to the entity type.
+void Resolver::resolve_entity_selector(ptr<EntitySelector> entity_selector, ptr<Scope> scope, optional<Pattern> pattern_hint)
+{
+    auto invalid_property = CREATE(InvalidProperty);
+    invalid_property->span = entity_selector->span;
+
+    // FIXME: As with enum values in resolve_index_with_identity, an Expression node cannot be an
+    //        EntityType, so we lookup the entity type 'manually' here.
+    if (IS(entity_selector->subject, UnresolvedLiteral) && IS_PTR(AS(entity_selector->subject, UnresolvedLiteral), IdentityLiteral))
+    {
+        auto subject_identity = AS_PTR(AS(entity_selector->subject, UnresolvedLiteral), IdentityLiteral)->identity;
+        if (declared_in_scope(scope, subject_identity))
+        {
+            auto resolved = fetch(scope, subject_identity);
+            if (IS(resolved, Pattern) && IS_PTR(AS(resolved, Pattern), EntityType))
+                entity_selector->entity_type = AS_PTR(AS(resolved, Pattern), EntityType);
+        }
+    }
+
+    if (!entity_selector->entity_type)
+    {
+        source->log_error("Entities can only be selected from an entity type.", get_span(entity_selector->subject));
+        entity_selector->property = invalid_property;
+        entity_selector->value = resolve_expression(entity_selector->value, scope);
+        return;
+    }
+
+    auto identity_literal = AS_PTR(entity_selector->property, IdentityLiteral);
+    auto all_overloads = fetch_all_overloads(scope, identity_literal->identity);
+
+    vector<Property> valid_overloads;
+    for (auto overload : all_overloads)
+    {
+        if (IS_PTR(overload, StateProperty))
+        {
+            auto state_property = AS_PTR(overload, StateProperty);
+            if (state_property->parameters.size() == 1 && is_pattern_subset_of_superset(entity_selector->entity_type, state_property->parameters[0]->pattern))
+                valid_overloads.push_back(state_property);
+        }
+        else if (IS_PTR(overload, FunctionProperty))
+        {
+            auto function_property = AS_PTR(overload, FunctionProperty);
+            if (function_property->parameters.size() == 1 && is_pattern_subset_of_superset(entity_selector->entity_type, function_property->parameters[0]->pattern))
+                valid_overloads.push_back(function_property);
+        }
+    }
+
+    if (valid_overloads.size() == 1)
+    {
+        auto property = valid_overloads[0];
+        auto property_pattern = IS_PTR(property, StateProperty) ? AS_PTR(property, StateProperty)->pattern : AS_PTR(property, FunctionProperty)->pattern;
+        entity_selector->property = property;
+        entity_selector->value = resolve_expression(entity_selector->value, scope, property_pattern);
+        return;
+    }
+
+    if (valid_overloads.size() == 0)
+        source->log_error("No property '" + identity_literal->identity + "' belongs to the '" + entity_selector->entity_type->identity + "' entity.", entity_selector->span);
+    else
+        source->log_error("Which version of the property '" + identity_literal->identity + "' to select by is ambiguous.", entity_selector->span);
+
+    entity_selector->property = invalid_property;
+    entity_selector->value = resolve_expression(entity_selector->value, scope);
+}
+
+void Resolver::resolve_list_operation(ptr<ListOperation> list_operation, ptr<Scope> scope, optional<Pattern> pattern_hint)
+{
+    list_operation->list = resolve_expression(list_operation->list, scope);
+
+    // The list is resolved before its contents are determined, so that the pattern of a variable such as a for
+    // loop's is known. The checker reports list operations on values that are not lists.
+    auto list_pattern = determine_expression_pattern(list_operation->list);
+    if (is_pattern_list(list_pattern))
+        list_operation->variable->pattern = determine_pattern_of_contents_of(list_pattern);
+    else
+        list_operation->variable->pattern = CREATE(InvalidPattern);
+
+    list_operation->scope->parent = scope;
+    list_operation->body = resolve_expression(list_operation->body, list_operation->scope);
+}
+
 void Resolver::resolve_unary(ptr<Unary> unary, ptr<Scope> scope, optional<Pattern> pattern_hint)
 {
     unary->value = resolve_expression(unary->value, scope);
@@ -45,6 +45,8 @@ private:
     void resolve_match(ptr<MatchExpression> match, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
     void resolve_index_with_expression(ptr<IndexWithExpression> index_with_expression, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
     Expression resolve_index_with_identity(ptr<IndexWithIdentity> index_with_identity, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
+    void resolve_entity_selector(ptr<EntitySelector> entity_selector, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
+    void resolve_list_operation(ptr<ListOperation> list_operation, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
     void resolve_unary(ptr<Unary> unary, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
     void resolve_binary(ptr<Binary> binary, ptr<Scope> scope, optional<Pattern> pattern_hint = {});
 
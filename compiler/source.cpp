@@ -15,6 +15,13 @@ Source::Source(string file_path)
     length = content.length();
 }
 
+Source::Source(string file_path, string content)
+{
+    this->file_path = file_path;
+    this->content = content;
+    length = content.length();
+}
+
 string Source::substr(size_t position)
 {
     return content.substr(position);
@@ -19,6 +19,7 @@ struct Source
     vector<GambitError> errors;
 
     Source(string file_path);
+    Source(string file_path, string content);
 
     string substr(size_t position);
     string substr(size_t position, size_t n);
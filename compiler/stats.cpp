@@ -0,0 +1,723 @@
+#include "json.h"
+#include "stats.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// INSTRUMENTATION COUNTERS
+
+namespace Instrument
+{
+    bool enabled = false;
+
+    atomic<size_t> allocations(0);
+    atomic<size_t> allocated_bytes(0);
+    atomic<size_t> scope_lookups(0);
+    atomic<size_t> scope_lookup_steps(0);
+}
+
+// ALLOCATION TRACKING
+// Replacing the global allocation functions lets us count every allocation made by the
+// compiler (including those made by the standard library on our behalf).
+
+void *operator new(size_t size)
+{
+    Instrument::count(Instrument::allocations);
+    Instrument::count(Instrument::allocated_bytes, size);
+
+    if (size == 0)
+        size = 1;
+
+    while (true)
+    {
+        if (void *memory = malloc(size))
+            return memory;
+
+        auto handler = get_new_handler();
+        if (handler == nullptr)
+            throw bad_alloc();
+        handler();
+    }
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// GCC pairs the `operator new` a caller uses with the `free` of this `operator delete` once it is
+// inlined, and warns that they don't match, although both are replaced to use `malloc` and `free`.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// The size is not needed to free memory from `malloc`, so sized deletes forward to the unsized ones
+void operator delete(void *memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    operator delete[](memory);
+}
+
+// PROCESS INFORMATION
+
+double process_cpu_ms()
+{
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return 0;
+
+    auto to_ms = [](FILETIME time)
+    {
+        ULARGE_INTEGER ticks;
+        ticks.LowPart = time.dwLowDateTime;
+        ticks.HighPart = time.dwHighDateTime;
+        return ticks.QuadPart / 10000.0; // FILETIME is measured in 100 nanosecond intervals
+    };
+
+    return to_ms(kernel_time) + to_ms(user_time);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    auto to_ms = [](timeval time)
+    {
+        return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+    };
+
+    return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+#endif
+}
+
+size_t process_peak_rss_bytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss; // Measured in bytes on macOS
+#else
+    return usage.ru_maxrss * 1024; // Measured in kilobytes on Linux
+#endif
+#endif
+}
+
+// COMPILER STATS
+
+CompilerStats::CompilerStats(bool enabled)
+    : enabled(enabled)
+{
+    Instrument::enabled = enabled;
+}
+
+CompilerStats::Sample CompilerStats::take_sample() const
+{
+    Sample sample;
+    sample.wall = chrono::steady_clock::now();
+    sample.cpu_ms = process_cpu_ms();
+    sample.allocations = Instrument::allocations.load();
+    sample.allocated_bytes = Instrument::allocated_bytes.load();
+    sample.scope_lookups = Instrument::scope_lookups.load();
+    sample.scope_lookup_steps = Instrument::scope_lookup_steps.load();
+    return sample;
+}
+
+void CompilerStats::start_phase(string name)
+{
+    if (!enabled)
+        return;
+
+    phases.emplace_back().name = name;
+    phase_start = take_sample();
+}
+
+void CompilerStats::finish_phase()
+{
+    if (!enabled)
+        return;
+
+    auto end = take_sample();
+    auto &phase = phases.back();
+    phase.wall_ms = chrono::duration<double, milli>(end.wall - phase_start.wall).count();
+    phase.cpu_ms = end.cpu_ms - phase_start.cpu_ms;
+    phase.allocations = end.allocations - phase_start.allocations;
+    phase.allocated_bytes = end.allocated_bytes - phase_start.allocated_bytes;
+    phase.scope_lookups = end.scope_lookups - phase_start.scope_lookups;
+    phase.scope_lookup_steps = end.scope_lookup_steps - phase_start.scope_lookup_steps;
+    phase.peak_rss_bytes = process_peak_rss_bytes();
+}
+
+void CompilerStats::record_tokens(const Source &source)
+{
+    if (!enabled)
+        return;
+
+    phases.back().tokens = source.tokens.size();
+}
+
+void CompilerStats::record_apm(ptr<Program> program)
+{
+    if (!enabled)
+        return;
+
+    // Counting allocates, and so should not be attributed to the next phase
+    Instrument::enabled = false;
+    phases.back().apm_nodes = count_apm_nodes(program);
+    Instrument::enabled = true;
+}
+
+string CompilerStats::to_text() const
+{
+    string text;
+    char line[256];
+
+    snprintf(line, sizeof line, "%-10s %10s %10s %12s %12s %12s %10s %12s\n",
+             "PHASE", "WALL MS", "CPU MS", "ALLOCS", "ALLOC KiB", "PEAK RSS KiB", "LOOKUPS", "LOOKUP STEPS");
+    text += line;
+
+    for (const auto &phase : phases)
+    {
+        snprintf(line, sizeof line, "%-10s %10.3f %10.3f %12zu %12.1f %12.1f %10zu %12zu\n",
+                 phase.name.c_str(),
+                 phase.wall_ms,
+                 phase.cpu_ms,
+                 phase.allocations,
+                 phase.allocated_bytes / 1024.0,
+                 phase.peak_rss_bytes / 1024.0,
+                 phase.scope_lookups,
+                 phase.scope_lookup_steps);
+        text += line;
+    }
+
+    for (const auto &phase : phases)
+    {
+        if (phase.tokens.has_value())
+            text += "\nTokens after " + phase.name + ": " + to_string(phase.tokens.value()) + "\n";
+    }
+
+    for (const auto &phase : phases)
+    {
+        if (!phase.apm_nodes.has_value())
+            continue;
+
+        size_t total = 0;
+        for (const auto &entry : phase.apm_nodes.value())
+            total += entry.second;
+
+        text += "\nAPM nodes after " + phase.name + ": " + to_string(total) + "\n";
+        for (const auto &entry : phase.apm_nodes.value())
+        {
+            snprintf(line, sizeof line, "  %-28s %8zu\n", entry.first.c_str(), entry.second);
+            text += line;
+        }
+    }
+
+    return text;
+}
+
+string CompilerStats::to_json() const
+{
+    JsonContainer json;
+    json.object();
+    json.array("phases");
+    for (const auto &phase : phases)
+    {
+        json.object();
+        json.add("name", phase.name);
+        json.add("wall_ms", phase.wall_ms);
+        json.add("cpu_ms", phase.cpu_ms);
+        json.add("allocations", phase.allocations);
+        json.add("allocated_bytes", phase.allocated_bytes);
+        json.add("peak_rss_bytes", phase.peak_rss_bytes);
+        json.add("scope_lookups", phase.scope_lookups);
+        json.add("scope_lookup_steps", phase.scope_lookup_steps);
+        if (phase.tokens.has_value())
+            json.add("tokens", phase.tokens.value());
+        if (phase.apm_nodes.has_value())
+            json.add("apm_nodes", phase.apm_nodes.value());
+        json.close();
+    }
+    json.close();
+    json.close();
+    return (string)json;
+}
+
+// APM NODE COUNTING
+
+struct ApmNodeCounter
+{
+    map<string, size_t> counts;
+    unordered_set<const void *> seen;
+
+    // Returns true the first time a node is visited, so that shared nodes are only counted (and walked) once
+    template <class T>
+    bool visit(const ptr<T> &node, const char *name)
+    {
+        if (node == nullptr || !seen.insert(node.get()).second)
+            return false;
+        counts[name]++;
+        return true;
+    }
+
+    void program(ptr<Program> node);
+    void scope(ptr<Scope> node);
+    void lookup_value(const Scope::LookupValue &value);
+    void procedure(ptr<Procedure> node);
+    void variable(ptr<Variable> node);
+    void state_property(ptr<StateProperty> node);
+    void function_property(ptr<FunctionProperty> node);
+    void code_block(ptr<CodeBlock> node);
+
+    void literal(const UnresolvedLiteral &literal);
+    void property(const Property &property);
+    void pattern(const Pattern &pattern);
+    void expression(const Expression &expression);
+    void statement(const Statement &statement);
+};
+
+#define VISIT(node, T)        \
+    if (!visit(node, #T))     \
+        return;
+
+void ApmNodeCounter::program(ptr<Program> node)
+{
+    VISIT(node, Program);
+    scope(node->global_scope);
+}
+
+void ApmNodeCounter::scope(ptr<Scope> node)
+{
+    VISIT(node, Scope);
+    for (const auto &entry : node->lookup)
+        lookup_value(entry.second);
+}
+
+void ApmNodeCounter::lookup_value(const Scope::LookupValue &value)
+{
+    if (IS_PTR(value, Scope::OverloadedIdentity))
+    {
+        auto node = AS_PTR(value, Scope::OverloadedIdentity);
+        VISIT(node, Scope::OverloadedIdentity);
+        for (const auto &overload : node->overloads)
+            lookup_value(overload);
+    }
+    else if (IS_PTR(value, Procedure))
+        procedure(AS_PTR(value, Procedure));
+    else if (IS_PTR(value, Variable))
+        variable(AS_PTR(value, Variable));
+    else if (IS_PTR(value, StateProperty))
+        state_property(AS_PTR(value, StateProperty));
+    else if (IS_PTR(value, FunctionProperty))
+        function_property(AS_PTR(value, FunctionProperty));
+    else if (IS(value, Pattern))
+        pattern(AS(value, Pattern));
+}
+
+void ApmNodeCounter::procedure(ptr<Procedure> node)
+{
+    VISIT(node, Procedure);
+    scope(node->scope);
+    for (const auto &parameter : node->parameters)
+        variable(parameter);
+    code_block(node->body);
+}
+
+void ApmNodeCounter::variable(ptr<Variable> node)
+{
+    VISIT(node, Variable);
+    pattern(node->pattern);
+}
+
+void ApmNodeCounter::state_property(ptr<StateProperty> node)
+{
+    VISIT(node, StateProperty);
+    pattern(node->pattern);
+    scope(node->scope);
+    for (const auto &parameter : node->parameters)
+        variable(parameter);
+    if (node->initial_value.has_value())
+        expression(node->initial_value.value());
+}
+
+void ApmNodeCounter::function_property(ptr<FunctionProperty> node)
+{
+    VISIT(node, FunctionProperty);
+    pattern(node->pattern);
+    scope(node->scope);
+    for (const auto &parameter : node->parameters)
+        variable(parameter);
+    if (node->body.has_value())
+        code_block(node->body.value());
+}
+
+void ApmNodeCounter::code_block(ptr<CodeBlock> node)
+{
+    VISIT(node, CodeBlock);
+    scope(node->scope);
+    for (const auto &stmt : node->statements)
+        statement(stmt);
+}
+
+void ApmNodeCounter::literal(const UnresolvedLiteral &literal)
+{
+    if (IS_PTR(literal, PrimitiveLiteral))
+    {
+        auto node = AS_PTR(literal, PrimitiveLiteral);
+        VISIT(node, PrimitiveLiteral);
+        expression(node->value);
+    }
+    else if (IS_PTR(literal, ListLiteral))
+    {
+        auto node = AS_PTR(literal, ListLiteral);
+        VISIT(node, ListLiteral);
+        for (const auto &value : node->values)
+            expression(value);
+    }
+    else if (IS_PTR(literal, IdentityLiteral))
+    {
+        visit(AS_PTR(literal, IdentityLiteral), "IdentityLiteral");
+    }
+    else if (IS_PTR(literal, OptionLiteral))
+    {
+        auto node = AS_PTR(literal, OptionLiteral);
+        VISIT(node, OptionLiteral);
+        this->literal(node->literal);
+    }
+}
+
+void ApmNodeCounter::property(const Property &property)
+{
+    if (IS_PTR(property, IdentityLiteral))
+        visit(AS_PTR(property, IdentityLiteral), "IdentityLiteral");
+    else if (IS_PTR(property, StateProperty))
+        state_property(AS_PTR(property, StateProperty));
+    else if (IS_PTR(property, FunctionProperty))
+        function_property(AS_PTR(property, FunctionProperty));
+    else if (IS_PTR(property, InvalidProperty))
+        visit(AS_PTR(property, InvalidProperty), "InvalidProperty");
+}
+
+void ApmNodeCounter::pattern(const Pattern &pattern)
+{
+    if (IS(pattern, UnresolvedLiteral))
+        literal(AS(pattern, UnresolvedLiteral));
+
+    else if (IS_PTR(pattern, PatternLiteral))
+    {
+        auto node = AS_PTR(pattern, PatternLiteral);
+        VISIT(node, PatternLiteral);
+        this->pattern(node->pattern);
+    }
+
+    else if (IS_PTR(pattern, AnyPattern))
+        visit(AS_PTR(pattern, AnyPattern), "AnyPattern");
+
+    else if (IS_PTR(pattern, UnionPattern))
+    {
+        auto node = AS_PTR(pattern, UnionPattern);
+        VISIT(node, UnionPattern);
+        for (const auto &sub_pattern : node->patterns)
+            this->pattern(sub_pattern);
+    }
+
+    else if (IS_PTR(pattern, PrimitiveValue))
+        expression(AS_PTR(pattern, PrimitiveValue));
+
+    else if (IS_PTR(pattern, EnumValue))
+        expression(AS_PTR(pattern, EnumValue));
+
+    else if (IS_PTR(pattern, PrimitiveType))
+        visit(AS_PTR(pattern, PrimitiveType), "PrimitiveType");
+
+    else if (IS_PTR(pattern, ListType))
+    {
+        auto node = AS_PTR(pattern, ListType);
+        VISIT(node, ListType);
+        this->pattern(node->list_of);
+        if (node->fixed_size.has_value())
+            expression(node->fixed_size.value());
+    }
+
+    else if (IS_PTR(pattern, EnumType))
+    {
+        auto node = AS_PTR(pattern, EnumType);
+        VISIT(node, EnumType);
+        for (const auto &value : node->values)
+            expression(value);
+    }
+
+    else if (IS_PTR(pattern, EntityType))
+        visit(AS_PTR(pattern, EntityType), "EntityType");
+
+    else if (IS_PTR(pattern, UninferredPattern))
+        visit(AS_PTR(pattern, UninferredPattern), "UninferredPattern");
+
+    else if (IS_PTR(pattern, InvalidPattern))
+        visit(AS_PTR(pattern, InvalidPattern), "InvalidPattern");
+}
+
+void ApmNodeCounter::expression(const Expression &expression)
+{
+    if (IS(expression, UnresolvedLiteral))
+        literal(AS(expression, UnresolvedLiteral));
+
+    else if (IS_PTR(expression, ExpressionLiteral))
+    {
+        auto node = AS_PTR(expression, ExpressionLiteral);
+        VISIT(node, ExpressionLiteral);
+        this->expression(node->expr);
+    }
+
+    else if (IS_PTR(expression, PrimitiveValue))
+    {
+        auto node = AS_PTR(expression, PrimitiveValue);
+        VISIT(node, PrimitiveValue);
+        pattern(node->type);
+    }
+
+    else if (IS_PTR(expression, ListValue))
+    {
+        auto node = AS_PTR(expression, ListValue);
+        VISIT(node, ListValue);
+        for (const auto &value : node->values)
+            this->expression(value);
+    }
+
+    else if (IS_PTR(expression, EnumValue))
+    {
+        auto node = AS_PTR(expression, EnumValue);
+        VISIT(node, EnumValue);
+        pattern(node->type);
+    }
+
+    else if (IS_PTR(expression, Variable))
+        variable(AS_PTR(expression, Variable));
+
+    else if (IS_PTR(expression, Unary))
+    {
+        auto node = AS_PTR(expression, Unary);
+        VISIT(node, Unary);
+        this->expression(node->value);
+    }
+
+    else if (IS_PTR(expression, Binary))
+    {
+        auto node = AS_PTR(expression, Binary);
+        VISIT(node, Binary);
+        this->expression(node->lhs);
+        this->expression(node->rhs);
+    }
+
+    else if (IS_PTR(expression, InstanceList))
+    {
+        auto node = AS_PTR(expression, InstanceList);
+        VISIT(node, InstanceList);
+        for (const auto &value : node->values)
+            this->expression(value);
+    }
+
+    else if (IS_PTR(expression, IndexWithExpression))
+    {
+        auto node = AS_PTR(expression, IndexWithExpression);
+        VISIT(node, IndexWithExpression);
+        this->expression(node->subject);
+        this->expression(node->index);
+    }
+
+    else if (IS_PTR(expression, IndexWithIdentity))
+    {
+        auto node = AS_PTR(expression, IndexWithIdentity);
+        VISIT(node, IndexWithIdentity);
+        this->expression(node->subject);
+        visit(node->index, "IdentityLiteral");
+    }
+
+    else if (IS_PTR(expression, EntitySelector))
+    {
+        auto node = AS_PTR(expression, EntitySelector);
+        VISIT(node, EntitySelector);
+        this->expression(node->subject);
+        this->expression(node->value);
+    }
+
+    else if (IS_PTR(expression, ListOperation))
+    {
+        auto node = AS_PTR(expression, ListOperation);
+        VISIT(node, ListOperation);
+        variable(node->variable);
+        this->expression(node->list);
+        this->expression(node->body);
+    }
+
+    else if (IS_PTR(expression, Call))
+    {
+        auto node = AS_PTR(expression, Call);
+        VISIT(node, Call);
+        this->expression(node->callee);
+        for (const auto &argument : node->arguments)
+            this->expression(argument.value);
+    }
+
+    else if (IS_PTR(expression, PropertyAccess))
+    {
+        auto node = AS_PTR(expression, PropertyAccess);
+        VISIT(node, PropertyAccess);
+        this->expression(node->subject);
+        property(node->property);
+    }
+
+    else if (IS_PTR(expression, ChooseExpression))
+    {
+        auto node = AS_PTR(expression, ChooseExpression);
+        VISIT(node, ChooseExpression);
+        this->expression(node->player);
+        this->expression(node->choices);
+        this->expression(node->prompt);
+        if (node->count.has_value())
+            this->expression(node->count.value());
+    }
+
+    else if (IS_PTR(expression, IfExpression))
+    {
+        auto node = AS_PTR(expression, IfExpression);
+        VISIT(node, IfExpression);
+        for (const auto &rule : node->rules)
+        {
+            this->expression(rule.condition);
+            this->expression(rule.result);
+        }
+    }
+
+    else if (IS_PTR(expression, MatchExpression))
+    {
+        auto node = AS_PTR(expression, MatchExpression);
+        VISIT(node, MatchExpression);
+        this->expression(node->subject);
+        for (const auto &rule : node->rules)
+        {
+            pattern(rule.pattern);
+            this->expression(rule.result);
+        }
+    }
+
+    else if (IS_PTR(expression, InvalidExpression))
+        visit(AS_PTR(expression, InvalidExpression), "InvalidExpression");
+}
+
+void ApmNodeCounter::statement(const Statement &statement)
+{
+    if (IS_PTR(statement, IfStatement))
+    {
+        auto node = AS_PTR(statement, IfStatement);
+        VISIT(node, IfStatement);
+        for (const auto &rule : node->rules)
+        {
+            expression(rule.condition);
+            code_block(rule.code_block);
+        }
+        if (node->else_block.has_value())
+            code_block(node->else_block.value());
+    }
+
+    else if (IS_PTR(statement, ForStatement))
+    {
+        auto node = AS_PTR(statement, ForStatement);
+        VISIT(node, ForStatement);
+        variable(node->variable);
+        expression(node->range);
+        scope(node->scope);
+        code_block(node->body);
+    }
+
+    else if (IS_PTR(statement, LoopStatement))
+    {
+        auto node = AS_PTR(statement, LoopStatement);
+        VISIT(node, LoopStatement);
+        scope(node->scope);
+        code_block(node->body);
+    }
+
+    else if (IS_PTR(statement, ReturnStatement))
+    {
+        auto node = AS_PTR(statement, ReturnStatement);
+        VISIT(node, ReturnStatement);
+        expression(node->value);
+    }
+
+    else if (IS_PTR(statement, WinsStatement))
+    {
+        auto node = AS_PTR(statement, WinsStatement);
+        VISIT(node, WinsStatement);
+        expression(node->player);
+    }
+
+    else if (IS_PTR(statement, DrawStatement))
+        visit(AS_PTR(statement, DrawStatement), "DrawStatement");
+
+    else if (IS_PTR(statement, AssignmentStatement))
+    {
+        auto node = AS_PTR(statement, AssignmentStatement);
+        VISIT(node, AssignmentStatement);
+        expression(node->subject);
+        expression(node->value);
+    }
+
+    else if (IS_PTR(statement, VariableDeclaration))
+    {
+        auto node = AS_PTR(statement, VariableDeclaration);
+        VISIT(node, VariableDeclaration);
+        variable(node->variable);
+        if (node->value.has_value())
+            expression(node->value.value());
+    }
+
+    else if (IS_PTR(statement, CodeBlock))
+        code_block(AS_PTR(statement, CodeBlock));
+
+    else if (IS(statement, Expression))
+        expression(AS(statement, Expression));
+}
+
+#undef VISIT
+
+map<string, size_t> count_apm_nodes(ptr<Program> program)
+{
+    ApmNodeCounter counter;
+    counter.program(program);
+    return counter.counts;
+}
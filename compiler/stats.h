@@ -0,0 +1,101 @@
+/*
+stats.h
+
+Records statistics about each phase of compilation (timings, memory usage, and counts of the
+work done) so that we can find out where compile time goes. Enabled with the `--stats` flag.
+*/
+
+#pragma once
+#ifndef STATS_H
+#define STATS_H
+
+#include "apm.h"
+#include "source.h"
+#include "utilty.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// INSTRUMENTATION COUNTERS
+// These are incremented from throughout the compiler, but only while `enabled` is set,
+// so that the instrumentation costs nothing more than a branch when stats are not wanted.
+
+namespace Instrument
+{
+    extern bool enabled;
+
+    extern atomic<size_t> allocations;
+    extern atomic<size_t> allocated_bytes;
+    extern atomic<size_t> scope_lookups;
+    extern atomic<size_t> scope_lookup_steps;
+
+    inline void count(atomic<size_t> &counter, size_t amount = 1)
+    {
+        if (enabled)
+            counter.fetch_add(amount, memory_order_relaxed);
+    }
+}
+
+// COMPILER STATS
+
+struct PhaseStats
+{
+    string name;
+    double wall_ms = 0;
+    double cpu_ms = 0;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    size_t peak_rss_bytes = 0;
+    size_t scope_lookups = 0;
+    size_t scope_lookup_steps = 0;
+
+    optional<size_t> tokens;
+    optional<map<string, size_t>> apm_nodes;
+};
+
+class CompilerStats
+{
+public:
+    CompilerStats(bool enabled);
+
+    bool enabled;
+    vector<PhaseStats> phases;
+
+    void start_phase(string name);
+    void finish_phase();
+
+    // Attach additional information to the phase that was most recently finished
+    void record_tokens(const Source &source);
+    void record_apm(ptr<Program> program);
+
+    string to_text() const;
+    string to_json() const;
+
+private:
+    struct Sample
+    {
+        chrono::steady_clock::time_point wall;
+        double cpu_ms;
+        size_t allocations;
+        size_t allocated_bytes;
+        size_t scope_lookups;
+        size_t scope_lookup_steps;
+    };
+
+    Sample phase_start;
+    Sample take_sample() const;
+};
+
+// APM NODE COUNTING
+// Counts each distinct node reachable from the program, grouped by the type of node.
+[[nodiscard]] map<string, size_t> count_apm_nodes(ptr<Program> program);
+
+// PROCESS INFORMATION
+[[nodiscard]] double process_cpu_ms();
+[[nodiscard]] size_t process_peak_rss_bytes();
+
+#endif
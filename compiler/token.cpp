@@ -48,6 +48,7 @@ const map<Token::Kind, string> token_name = {
     {Token::KeyEnum, "KeyEnum"},
     {Token::KeyFn, "KeyFn"},
     {Token::KeyState, "KeyState"},
+    {Token::KeyHidden, "KeyHidden"},
     {Token::KeyBreak, "KeyBreak"},
     {Token::KeyContinue, "KeyContinue"},
     {Token::KeyWins, "KeyWins"},
@@ -116,6 +117,7 @@ const map<string, Token::Kind> keyword_match_rules = {
     {"fn", Token::KeyFn},
 
     {"state", Token::KeyState},
+    {"hidden", Token::KeyHidden},
 
     {"break", Token::KeyBreak},
     {"continue", Token::KeyContinue},
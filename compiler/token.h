@@ -46,6 +46,7 @@ struct Token
         KeyEnum,
         KeyFn,
         KeyState,
+        KeyHidden,
         KeyBreak,
         KeyContinue,
         KeyWins,
@@ -0,0 +1,224 @@
+#include "intrinsic.h"
+#include "json.h"
+#include "trace.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Trace
+{
+    bool enabled = false;
+
+    struct Event
+    {
+        const char *category;
+        string name;
+        string identity;
+        double start_us;
+        double duration_us;
+        size_t thread;
+    };
+
+    static mutex events_mutex;
+    static vector<Event> events;
+    static size_t thread_count = 0;
+    static const auto session_start = chrono::steady_clock::now();
+
+    // Threads are numbered in the order they first record an event, which keeps the
+    // track ids in the trace small and stable between runs.
+    static size_t current_thread()
+    {
+        thread_local size_t thread = 0;
+        if (thread == 0)
+        {
+            lock_guard<mutex> lock(events_mutex);
+            thread = ++thread_count;
+        }
+        return thread;
+    }
+
+    void record(const char *category, string name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end, string identity)
+    {
+        Event event;
+        event.category = category;
+        event.name = name;
+        event.identity = identity;
+        event.start_us = chrono::duration<double, micro>(start - session_start).count();
+        event.duration_us = chrono::duration<double, micro>(end - start).count();
+        event.thread = current_thread();
+
+        lock_guard<mutex> lock(events_mutex);
+        events.emplace_back(event);
+    }
+
+    string to_json()
+    {
+        lock_guard<mutex> lock(events_mutex);
+
+        JsonContainer json;
+        json.object();
+        json.add("displayTimeUnit", string("ms"));
+        json.array("traceEvents");
+
+        json.object();
+        json.add("name", string("process_name"));
+        json.add("ph", string("M"));
+        json.add("pid", 1);
+        json.object("args");
+        json.add("name", string("gambit"));
+        json.close();
+        json.close();
+
+        for (size_t thread = 1; thread <= thread_count; thread++)
+        {
+            json.object();
+            json.add("name", string("thread_name"));
+            json.add("ph", string("M"));
+            json.add("pid", 1);
+            json.add("tid", thread);
+            json.object("args");
+            json.add("name", thread == 1 ? string("main") : "worker " + to_string(thread - 1));
+            json.close();
+            json.close();
+        }
+
+        for (const auto &event : events)
+        {
+            json.object();
+            json.add("name", event.name);
+            json.add("cat", string(event.category));
+            json.add("ph", string("X"));
+            json.add("ts", event.start_us);
+            json.add("dur", event.duration_us);
+            json.add("pid", 1);
+            json.add("tid", event.thread);
+            if (event.identity != "")
+            {
+                json.object("args");
+                json.add("identity", event.identity);
+                json.close();
+            }
+            json.close();
+        }
+
+        json.close();
+        json.close();
+        return (string)json;
+    }
+}
+
+// TRACE SCOPE
+
+// Patterns are described as they are written, so that a signature reads the same before and after it is resolved
+static string describe_pattern(const Pattern &pattern)
+{
+    if (IS(pattern, UnresolvedLiteral))
+    {
+        auto literal = AS(pattern, UnresolvedLiteral);
+        if (IS_PTR(literal, IdentityLiteral))
+            return AS_PTR(literal, IdentityLiteral)->identity;
+        if (IS_PTR(literal, OptionLiteral))
+            return describe_pattern(AS_PTR(literal, OptionLiteral)->literal) + "?";
+        if (IS_PTR(literal, ListLiteral))
+        {
+            auto values = AS_PTR(literal, ListLiteral)->values;
+            if (values.size() > 0 && IS(values[0], UnresolvedLiteral))
+                return "[" + describe_pattern(AS(values[0], UnresolvedLiteral)) + "]";
+        }
+        return "?";
+    }
+
+    if (IS_PTR(pattern, PatternLiteral))
+        return describe_pattern(AS_PTR(pattern, PatternLiteral)->pattern);
+
+    if (IS_PTR(pattern, AnyPattern))
+        return "any";
+
+    if (IS_PTR(pattern, UnionPattern))
+    {
+        auto patterns = AS_PTR(pattern, UnionPattern)->patterns;
+        if (patterns.size() == 2 && IS_PTR(patterns[1], PrimitiveValue) && AS_PTR(patterns[1], PrimitiveValue) == Intrinsic::none_val)
+            return describe_pattern(patterns[0]) + "?";
+
+        string description;
+        for (const auto &sub_pattern : patterns)
+        {
+            if (description != "")
+                description += " | ";
+            description += describe_pattern(sub_pattern);
+        }
+        return description;
+    }
+
+    if (IS_PTR(pattern, PrimitiveValue))
+        return AS_PTR(pattern, PrimitiveValue) == Intrinsic::none_val ? "none" : AS_PTR(pattern, PrimitiveValue)->type->identity;
+    if (IS_PTR(pattern, EnumValue))
+        return AS_PTR(pattern, EnumValue)->type->identity + "." + AS_PTR(pattern, EnumValue)->identity;
+
+    if (IS_PTR(pattern, PrimitiveType))
+        return AS_PTR(pattern, PrimitiveType)->identity;
+    if (IS_PTR(pattern, ListType))
+        return "[" + describe_pattern(AS_PTR(pattern, ListType)->list_of) + "]";
+    if (IS_PTR(pattern, EnumType))
+        return AS_PTR(pattern, EnumType)->identity;
+    if (IS_PTR(pattern, EntityType))
+        return AS_PTR(pattern, EntityType)->identity;
+
+    return "?";
+}
+
+TraceScope::TraceScope(const char *category)
+    : active(Trace::enabled),
+      category(category)
+{
+    if (!active)
+        return;
+
+    name = category;
+    start = chrono::steady_clock::now();
+}
+
+TraceScope::TraceScope(const char *category, const Scope::LookupValue &value)
+    : active(false),
+      category(category)
+{
+    if (!Trace::enabled)
+        return;
+
+    if (IS_PTR(value, Procedure))
+        name = "procedure " + AS_PTR(value, Procedure)->identity;
+    else if (IS_PTR(value, StateProperty))
+        name = "state " + AS_PTR(value, StateProperty)->identity;
+    else if (IS_PTR(value, FunctionProperty))
+        name = "fn " + AS_PTR(value, FunctionProperty)->identity;
+    else
+        return;
+
+    active = true;
+    identity = identity_of(value);
+
+    // Include the types of the parameters so that overloads of the same property can be told apart
+    if (IS_PTR(value, StateProperty) || IS_PTR(value, FunctionProperty))
+    {
+        auto parameters = IS_PTR(value, StateProperty)
+                              ? AS_PTR(value, StateProperty)->parameters
+                              : AS_PTR(value, FunctionProperty)->parameters;
+
+        string signature;
+        for (const auto &parameter : parameters)
+        {
+            if (signature != "")
+                signature += ", ";
+            signature += describe_pattern(parameter->pattern);
+        }
+        name += " (" + signature + ")";
+    }
+
+    start = chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope()
+{
+    if (active)
+        Trace::record(category, name, start, chrono::steady_clock::now(), identity);
+}
@@ -0,0 +1,52 @@
+/*
+trace.h
+
+Records scoped events in the Chrome trace event format, so that a compilation can be
+inspected in chrome://tracing or https://ui.perfetto.dev. Enabled with the `--trace` flag.
+
+Events are recorded with the thread that produced them, so work spread across threads
+will show up on separate tracks.
+*/
+
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "apm.h"
+#include <chrono>
+#include <string>
+using namespace std;
+
+namespace Trace
+{
+    extern bool enabled;
+
+    void record(const char *category, string name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end, string identity = "");
+
+    [[nodiscard]] string to_json();
+}
+
+// Records an event covering the lifetime of the TraceScope.
+//
+// When given a Scope::LookupValue, an event is only recorded if the value is a definition
+// (a procedure or property). This means that passes which walk every value in a scope only
+// produce events for the work that is interesting to look at.
+class TraceScope
+{
+public:
+    TraceScope(const char *category);
+    TraceScope(const char *category, const Scope::LookupValue &value);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    bool active;
+    const char *category;
+    string name;
+    string identity;
+    chrono::steady_clock::time_point start;
+};
+
+#endif
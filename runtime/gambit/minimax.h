@@ -0,0 +1,302 @@
+/*
+minimax.h
+
+An alpha-beta player for the programs generated by the Gambit compiler. Small games can be searched
+to the end, where it plays perfectly rather than as well as its simulations allow.
+
+As with the Monte-Carlo search, the game cannot be resumed part way through the program, so each
+node is reached by playing the game again from the start with the choices that lead to it. The
+search deepens one choice at a time, and tries the best choice of the last depth first at each node,
+which it keeps in a transposition table shared by every thread (Lazy SMP). Values do not depend on
+where the search started, so the table is kept from one choice of the game to the next.
+
+The other players are assumed to play against the searching player, so that the search works for
+any number of players, and for players that make several choices in a row. A game that has an
+evaluation function is evaluated where the search stops, and otherwise counts as a draw there.
+*/
+
+#pragma once
+#ifndef GAMBIT_MINIMAX_H
+#define GAMBIT_MINIMAX_H
+
+#include "runtime.h"
+#include "transposition.h"
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace gambit
+{
+    struct MinimaxOptions
+    {
+        size_t depth = 64;  // The most choices to search ahead
+        size_t time_ms = 0; // No limit when 0
+        size_t threads = 0; // Every core when 0
+        uint64_t seed = 0;  // The seed of the game's randomness
+    };
+
+    class Minimax
+    {
+    public:
+        Minimax(void (*play)(), uint64_t (*hash)(), double (*evaluate)(uint32_t), const std::vector<size_t> &history, const MinimaxOptions &options, TranspositionTable &table)
+            : play(play), hash(hash), evaluate(evaluate), history(history), options(options), table(table) {}
+
+        size_t run()
+        {
+            size_t thread_count = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+            start = std::chrono::steady_clock::now();
+
+            // As with the Monte-Carlo search, the game being played has its state on this thread
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < thread_count; i++)
+                threads.emplace_back([this, i]
+                                     { work(i); });
+            for (auto &thread : threads)
+                thread.join();
+
+            return best;
+        }
+
+        size_t nodes() const { return node_count.load(); }
+        size_t depth() const { return completed_depth; }
+        double seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+    private:
+        // Wins are worth more than any evaluation, and sooner wins more than later ones. Their value
+        // depends on the number of choices made in the game, rather than since the search started.
+        static constexpr int32_t WIN = 1000000000;
+        static constexpr int32_t EVALUATION_LIMIT = WIN / 2;
+
+        enum Bound : uint64_t
+        {
+            EXACT,
+            LOWER,
+            UPPER,
+        };
+
+        // Entries searched to the end of the game are valid at any depth
+        static constexpr uint64_t COMPLETE = 0xFF;
+        static constexpr uint64_t NO_CHOICE = (uint64_t(1) << 22) - 1;
+
+        void (*play)();
+        uint64_t (*hash)();
+        double (*evaluate)(uint32_t);
+        const std::vector<size_t> &history;
+        MinimaxOptions options;
+        TranspositionTable &table;
+
+        std::chrono::steady_clock::time_point start;
+        std::atomic<size_t> node_count{0};
+        std::atomic<bool> stopped{false};
+        size_t best = 0;
+        size_t completed_depth = 0;
+
+        std::atomic<uint32_t> root_player{0};
+
+        struct Stopped
+        {
+        };
+
+        // The node at the end of a path, found by playing the game with the choices of the path
+        struct Node
+        {
+            bool over = false;
+            int32_t value = 0; // Of a game that is over, or of the evaluation
+            uint32_t player = 0;
+            size_t count = 0;
+            uint64_t key = 0;
+        };
+
+        struct Reached
+        {
+        };
+
+        struct Probe : Chooser
+        {
+            const std::vector<size_t> &path;
+            Minimax &search;
+            bool evaluating;
+            Node &node;
+            size_t depth = 0;
+
+            Probe(const std::vector<size_t> &path, Minimax &search, bool evaluating, Node &node)
+                : path(path), search(search), evaluating(evaluating), node(node) {}
+
+            size_t choose(uint32_t player, const char *prompt, size_t count, const std::function<std::string(size_t)> &) override
+            {
+                if (depth < path.size())
+                    return path[depth++];
+
+                // The same state can be reached by different code, so the choice and the number of
+                // choices made so far are part of its key, as is the player the values are for
+                uint32_t root_player = search.root_player.load(std::memory_order_relaxed);
+                node.player = player;
+                node.count = count;
+                node.key = mix(search.hash() ^ mix((uint64_t)(uintptr_t)prompt ^ mix(depth ^ ((uint64_t)player << 32) ^ ((uint64_t)root_player << 48)))) ^ count;
+                if (evaluating && search.evaluate)
+                {
+                    double value = search.evaluate(root_player);
+                    node.value = (int32_t)std::lround(std::max<double>(-EVALUATION_LIMIT, std::min<double>(EVALUATION_LIMIT, value)));
+                }
+                throw Reached();
+            }
+        };
+
+        Node probe(const std::vector<size_t> &path, bool evaluating)
+        {
+            node_count.fetch_add(1, std::memory_order_relaxed);
+            if (stopped.load(std::memory_order_relaxed))
+                throw Stopped();
+            if (options.time_ms > 0 && seconds() * 1000 >= options.time_ms)
+            {
+                stopped.store(true);
+                throw Stopped();
+            }
+
+            Node node;
+            Probe chooser_probe(path, *this, evaluating, node);
+            chooser = &chooser_probe;
+            game_random.seed(options.seed);
+
+            // Games that end without a result are a draw
+            try
+            {
+                play();
+                node.over = true;
+            }
+            catch (const GameOver &result)
+            {
+                node.over = true;
+                uint32_t player = root_player.load(std::memory_order_relaxed);
+                node.value = result.winner == 0 ? 0 : result.winner == player ? WIN - (int32_t)path.size()
+                                                                               : -WIN + (int32_t)path.size();
+            }
+            catch (const Reached &)
+            {
+            }
+
+            chooser = nullptr;
+            return node;
+        }
+
+        int32_t search(std::vector<size_t> &path, size_t depth, int32_t alpha, int32_t beta, size_t ply, size_t thread_index, bool &complete)
+        {
+            Node node = probe(path, depth == 0);
+            if (node.over)
+                return node.value;
+            if (depth == 0)
+            {
+                complete = false;
+                return node.value;
+            }
+
+            // The table holds the value with a bound, the depth searched and the best choice
+            size_t first = 0;
+            uint64_t entry;
+            if (table.probe(node.key, entry))
+            {
+                int32_t value = (int32_t)(uint32_t)entry;
+                uint64_t searched = (entry >> 32) & 0xFF;
+                Bound bound = (Bound)((entry >> 40) & 0x3);
+                uint64_t choice = entry >> 42;
+                if (choice < node.count)
+                    first = choice;
+
+                if (searched >= depth && ply > 0)
+                {
+                    if (bound == EXACT || (bound == LOWER && value >= beta) || (bound == UPPER && value <= alpha))
+                    {
+                        complete = complete && searched == COMPLETE;
+                        return value;
+                    }
+                }
+            }
+
+            bool maximising = node.player == root_player.load(std::memory_order_relaxed);
+            int32_t original_alpha = alpha;
+            int32_t original_beta = beta;
+            int32_t best_value = maximising ? -WIN - 1 : WIN + 1;
+            size_t best_choice = first;
+            bool subtree_complete = true;
+
+            // Threads after the first try the choices in a different order, so that they search different parts of the tree
+            for (size_t i = 0; i < node.count; i++)
+            {
+                size_t choice = i == 0 ? first : (i - 1 + thread_index) % (node.count - 1);
+                if (i > 0 && choice >= first)
+                    choice++;
+
+                path.push_back(choice);
+                int32_t value = search(path, depth - 1, alpha, beta, ply + 1, thread_index, subtree_complete);
+                path.pop_back();
+
+                if (maximising ? value > best_value : value < best_value)
+                {
+                    best_value = value;
+                    best_choice = choice;
+                }
+                if (maximising)
+                    alpha = std::max(alpha, value);
+                else
+                    beta = std::min(beta, value);
+                if (alpha >= beta)
+                    break;
+            }
+
+            Bound bound = best_value <= original_alpha ? UPPER : best_value >= original_beta ? LOWER
+                                                                                             : EXACT;
+            uint64_t searched = subtree_complete ? COMPLETE : std::min<uint64_t>(depth, COMPLETE - 1);
+            if (best_choice < NO_CHOICE)
+                table.store(node.key, (uint64_t)(uint32_t)best_value | (searched << 32) | ((uint64_t)bound << 40) | ((uint64_t)best_choice << 42));
+
+            complete = complete && subtree_complete;
+            if (ply == 0 && thread_index == 0)
+                root_choice = best_choice;
+            return best_value;
+        }
+
+        size_t root_choice = 0;
+
+        void work(size_t thread_index)
+        {
+            Journal undo;
+            journal = &undo;
+
+            std::vector<size_t> path = history;
+            try
+            {
+                Node root = probe(path, false);
+                if (root.over)
+                    error("The search started from a game that is over.");
+                root_player.store(root.player, std::memory_order_relaxed);
+
+                // Helper threads start one depth ahead of each other, to fill the table for the main thread
+                for (size_t depth = 1 + thread_index % 2; depth <= options.depth; depth++)
+                {
+                    bool complete = true;
+                    search(path, depth, -WIN - 1, WIN + 1, 0, thread_index, complete);
+
+                    if (thread_index == 0)
+                    {
+                        best = root_choice;
+                        completed_depth = depth;
+                        if (complete)
+                            break;
+                    }
+                }
+            }
+            catch (const Stopped &)
+            {
+            }
+
+            chooser = nullptr;
+            journal = nullptr;
+
+            // The search is over once the main thread has finished
+            if (thread_index == 0)
+                stopped.store(true);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,1127 @@
+/*
+runtime.h
+
+Support code for the C++ programs generated by the Gambit compiler.
+*/
+
+#pragma once
+#ifndef GAMBIT_RUNTIME_H
+#define GAMBIT_RUNTIME_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace gambit
+{
+    [[noreturn]] inline void error(const char *message)
+    {
+        std::cerr << "Error: " << message << std::endl;
+        std::exit(1);
+    }
+
+    // RESULTS
+
+    // NOTE: The game is over as soon as a player wins or there is a draw, so the result is thrown
+    //       to unwind out of whatever the game was doing.
+    struct GameOver
+    {
+        uint32_t winner; // 0 if the game was a draw
+    };
+
+    [[noreturn]] inline void wins(uint32_t player)
+    {
+        throw GameOver{player};
+    }
+
+    [[noreturn]] inline void draw()
+    {
+        throw GameOver{0};
+    }
+
+    inline void report(const GameOver &result)
+    {
+        if (result.winner == 0)
+            std::cout << "The game is a draw." << std::endl;
+        else
+            std::cout << "Player " << result.winner << " wins." << std::endl;
+    }
+
+    // UNDO
+
+    // NOTE: While a journal is recording, every write to the state first saves the bytes it will
+    //       overwrite, so that rolling back to a mark restores them in reverse, at a cost that
+    //       depends on the number of writes rather than the size of the state.
+    struct Journal
+    {
+        struct Entry
+        {
+            void *address;
+            uint32_t size;
+            uint32_t offset; // Of the saved bytes
+        };
+
+        std::vector<Entry> entries;
+        std::vector<unsigned char> saved;
+        const void *state = nullptr; // The state that was cleared when recording started
+
+        size_t mark() const { return entries.size(); }
+
+        void save(void *address, size_t size)
+        {
+            size_t offset = saved.size();
+            saved.resize(offset + size);
+            std::memcpy(saved.data() + offset, address, size);
+            entries.push_back({address, (uint32_t)size, (uint32_t)offset});
+        }
+
+        void rollback(size_t mark)
+        {
+            while (entries.size() > mark)
+            {
+                const auto &entry = entries.back();
+                std::memcpy(entry.address, saved.data() + entry.offset, entry.size);
+                saved.resize(entry.offset);
+                entries.pop_back();
+            }
+        }
+    };
+
+    // The journal of the current thread, which records the writes to its state when set
+    inline thread_local Journal *journal = nullptr;
+
+    template <typename T>
+    void record(T &location)
+    {
+        if (journal)
+            journal->save(&location, sizeof(T));
+    }
+
+    // Clears the state for a new game. When the journal recorded the last game from a cleared
+    // state, its writes are undone instead of the whole state being cleared.
+    template <typename State>
+    void reset(State &state)
+    {
+        if (journal && journal->state == &state)
+        {
+            journal->rollback(0);
+            return;
+        }
+
+        state = {};
+        if (journal)
+        {
+            journal->entries.clear();
+            journal->saved.clear();
+            journal->state = &state;
+        }
+    }
+
+    // STATE
+
+    // NOTE: The game state is a single block that is cloned with `memcpy`, so the containers it
+    //       is made of hold their values inline, or in the arena at the end of the block.
+
+    // A column or table of values that each fit in `Bits` bits. Values do not straddle words.
+    template <typename T, unsigned Bits, size_t N>
+    struct Packed
+    {
+        static constexpr unsigned per_word = 64 / Bits;
+        static constexpr uint64_t mask = Bits == 64 ? ~uint64_t(0) : (uint64_t(1) << Bits) - 1;
+
+        uint64_t words[(N + per_word - 1) / per_word];
+
+        T get(size_t index) const
+        {
+            unsigned shift = (index % per_word) * Bits;
+            return static_cast<T>((words[index / per_word] >> shift) & mask);
+        }
+
+        void set(size_t index, T value)
+        {
+            unsigned shift = (index % per_word) * Bits;
+            uint64_t &word = words[index / per_word];
+            word = (word & ~(mask << shift)) | ((uint64_t(value) & mask) << shift);
+        }
+    };
+
+    // A list with at most `N` elements
+    template <typename T, size_t N>
+    struct List
+    {
+        uint32_t count;
+        T items[N];
+
+        List() = default;
+        List(const std::vector<T> &values)
+        {
+            if (values.size() > N)
+                error("Too many values were given for a list of state.");
+
+            count = (uint32_t)values.size();
+            for (size_t i = 0; i < values.size(); i++)
+                items[i] = values[i];
+        }
+
+        List(std::initializer_list<T> values)
+        {
+            if (values.size() > N)
+                error("Too many values were given for a list of state.");
+
+            count = 0;
+            for (const T &value : values)
+                items[count++] = value;
+        }
+
+        template <size_t M>
+        List(const List<T, M> &values)
+        {
+            if (values.size() > N)
+                error("Too many values were given for a list of state.");
+
+            count = (uint32_t)values.size();
+            for (size_t i = 0; i < values.size(); i++)
+                items[i] = values[i];
+        }
+
+        // Lists of lists convert each of their elements as well
+        template <typename U>
+        operator std::vector<U>() const { return std::vector<U>(begin(), end()); }
+
+        size_t size() const { return count; }
+        T *begin() { return items; }
+        T *end() { return items + count; }
+        const T *begin() const { return items; }
+        const T *end() const { return items + count; }
+        T &operator[](size_t index) { return items[index]; }
+        const T &operator[](size_t index) const { return items[index]; }
+
+        void push_back(const T &value)
+        {
+            if (count == N)
+                error("Too many values were inserted into a list of state.");
+            items[count++] = value;
+        }
+    };
+
+    // NOTE: A reverse index of a column, from each of its `Values` values to the entities with that
+    //       value, so that an entity can be selected by its value without scanning the column. Each
+    //       value has a bitset of entities, and the index is kept up to date by `assign`.
+    template <size_t Values, size_t N>
+    struct ReverseIndex
+    {
+        static constexpr size_t words = (N + 63) / 64;
+
+        uint64_t bits[Values][words];
+
+        void update(size_t index, size_t from, size_t to)
+        {
+            record(bits[from][index / 64]);
+            record(bits[to][index / 64]);
+            bits[from][index / 64] &= ~(uint64_t(1) << (index % 64));
+            bits[to][index / 64] |= uint64_t(1) << (index % 64);
+        }
+
+        // The entity with the lowest id that has the value, or 0 (`none`) if there isn't one
+        uint32_t first(size_t value) const
+        {
+            if (value >= Values)
+                return 0;
+
+            for (size_t i = 0; i < words; i++)
+                if (bits[value][i] != 0)
+                    return (uint32_t)(i * 64 + __builtin_ctzll(bits[value][i]));
+            return 0;
+        }
+    };
+
+    // The entity with the lowest id that the predicate holds for, or 0 (`none`) if there isn't one
+    template <typename Predicate>
+    uint32_t first_where(uint32_t count, Predicate predicate)
+    {
+        for (uint32_t entity = 1; entity <= count; entity++)
+            if (predicate(entity))
+                return entity;
+        return 0;
+    }
+
+    // NOTE: Lists of state without a fixed size, and sparse tables, are kept in an arena at the end
+    //       of the state block, so that the block can still be cloned with `memcpy`. A list refers to
+    //       its elements by their offset into the arena, and moves to a region twice the size when it
+    //       is full. Regions are not reused, as the whole state is reset at the start of each game.
+    //       Regions that do not fit in the arena are allocated from overflow blocks of the thread,
+    //       which never move, so that the journal can still restore them. The overflow is part of
+    //       the state, so a copy of the state that is played later must keep it (see `Clone`).
+    template <size_t Bytes>
+    struct Arena
+    {
+        uint32_t used;
+        alignas(8) unsigned char bytes[Bytes];
+    };
+
+    // The arena of the state of the current thread, which is set when the state is reset
+    struct ArenaAccess
+    {
+        unsigned char *bytes = nullptr;
+        uint32_t *used = nullptr;
+        size_t size = 0;
+
+        // Offsets from `2^shift` are into the overflow, where each block holds the offsets from
+        // `2^(shift + block)` up to the start of the next, so that the blocks double in size
+        unsigned shift = 0;
+        std::unique_ptr<unsigned char[]> blocks[32];
+
+        size_t overflow_start() const { return size_t(1) << shift; }
+        unsigned block_of(size_t offset) const { return 63 - __builtin_clzll(offset) - shift; }
+
+        unsigned char *at(size_t offset) const
+        {
+            if (offset < size)
+                return bytes + offset;
+
+            unsigned block = block_of(offset);
+            return blocks[block].get() + (offset - (overflow_start() << block));
+        }
+
+        unsigned char *block(unsigned block)
+        {
+            if (!blocks[block])
+                blocks[block].reset(new unsigned char[overflow_start() << block]);
+            return blocks[block].get();
+        }
+    };
+
+    inline thread_local ArenaAccess arena;
+
+    template <size_t Bytes>
+    void use_arena(Arena<Bytes> &state_arena)
+    {
+        arena.bytes = state_arena.bytes;
+        arena.used = &state_arena.used;
+        arena.size = Bytes;
+
+        arena.shift = 12;
+        while (arena.overflow_start() < Bytes)
+            arena.shift++;
+    }
+
+    inline uint32_t allocate(size_t bytes, size_t alignment)
+    {
+        size_t offset = (*arena.used + alignment - 1) / alignment * alignment;
+        if (offset + bytes <= arena.size)
+        {
+            *arena.used = (uint32_t)(offset + bytes);
+            return (uint32_t)offset;
+        }
+
+        // Regions do not straddle overflow blocks, so a region that does not fit in the rest of
+        // a block starts the next one
+        size_t start = arena.overflow_start();
+        offset = std::max(offset, start);
+        unsigned block = arena.block_of(offset);
+        while (offset + bytes > start << (block + 1))
+            offset = start << ++block;
+
+        if (offset + bytes > std::numeric_limits<uint32_t>::max())
+            error("The game state has run out of space.");
+
+        arena.block(block);
+        *arena.used = (uint32_t)(offset + bytes);
+        return (uint32_t)offset;
+    }
+
+    // Copies the overflow of the arena of the current thread, for a copy of the state to keep
+    inline void save_overflow(std::vector<unsigned char> &saved)
+    {
+        saved.clear();
+        size_t start = arena.overflow_start();
+        if (!arena.used || *arena.used <= start)
+            return;
+
+        saved.resize(*arena.used - start);
+        for (unsigned block = 0; (start << block) < *arena.used; block++)
+            if (arena.blocks[block])
+            {
+                size_t end = std::min<size_t>(start << (block + 1), *arena.used);
+                std::memcpy(saved.data() + ((start << block) - start), arena.blocks[block].get(), end - (start << block));
+            }
+    }
+
+    inline void restore_overflow(const std::vector<unsigned char> &saved)
+    {
+        size_t start = arena.overflow_start();
+        for (unsigned block = 0; (start << block) - start < saved.size(); block++)
+        {
+            size_t end = std::min<size_t>(start << (block + 1), start + saved.size());
+            std::memcpy(arena.block(block), saved.data() + ((start << block) - start), end - (start << block));
+        }
+    }
+
+    // A copy of the state of a thread that doesn't share its overflow, so it stays as it was while
+    // the thread plays on, and can be restored on any thread
+    template <typename State>
+    struct Clone
+    {
+        State state;
+        std::vector<unsigned char> overflow;
+    };
+
+    // `from` must be the state of the current thread, as the overflow is the thread's
+    template <typename State>
+    void clone(Clone<State> &to, const State &from)
+    {
+        std::memcpy(&to.state, &from, sizeof(State));
+        save_overflow(to.overflow);
+    }
+
+    // The arena of the thread must be the arena of `to`
+    template <typename State>
+    void restore(State &to, const Clone<State> &from)
+    {
+        std::memcpy(&to, &from.state, sizeof(State));
+        restore_overflow(from.overflow);
+    }
+
+    // A list of any length, with its elements in the arena
+    template <typename T>
+    struct Buffer
+    {
+        uint32_t offset;
+        uint32_t count;
+        uint32_t capacity;
+
+        operator std::vector<T>() const { return std::vector<T>(begin(), end()); }
+
+        size_t size() const { return count; }
+        T *begin() { return reinterpret_cast<T *>(arena.at(offset)); }
+        T *end() { return begin() + count; }
+        const T *begin() const { return reinterpret_cast<const T *>(arena.at(offset)); }
+        const T *end() const { return begin() + count; }
+        T &operator[](size_t index) { return begin()[index]; }
+        const T &operator[](size_t index) const { return begin()[index]; }
+
+        void reserve(size_t size)
+        {
+            if (size <= capacity)
+                return;
+
+            size_t new_capacity = std::max<size_t>({size, capacity * 2, 4});
+            uint32_t new_offset = allocate(new_capacity * sizeof(T), alignof(T));
+            std::memcpy(arena.at(new_offset), arena.at(offset), count * sizeof(T));
+            offset = new_offset;
+            capacity = (uint32_t)new_capacity;
+        }
+
+        void push_back(const T &value)
+        {
+            reserve(count + 1);
+            begin()[count++] = value;
+        }
+
+        template <typename Values>
+        void assign(const Values &values)
+        {
+            size_t size = values.size();
+            reserve(size);
+
+            size_t i = 0;
+            for (const auto &value : values)
+                begin()[i++] = T(value);
+            count = (uint32_t)size;
+        }
+    };
+
+    // NOTE: A table that only stores the entries that are not its default value, using open
+    //       addressing with linear probing, in a region of the arena. Entries are removed by moving
+    //       the entries after them back, so that a lookup stops at the first empty slot. The table
+    //       has room for `Capacity` entries at first, and moves to a region twice the size when it
+    //       is three quarters full.
+    template <typename T, size_t Capacity>
+    struct Sparse
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "The capacity of a sparse table must be a power of two");
+
+        uint32_t count;
+        uint32_t capacity; // 0 until an entry is first stored
+        uint32_t offset;   // Of the region, which holds the keys and then the values
+        T fallback;        // The value of every entry that is not stored
+
+        static size_t values_offset(size_t capacity) { return (capacity * sizeof(uint32_t) + alignof(T) - 1) / alignof(T) * alignof(T); }
+
+        // The index of each entry plus one, or 0 for an empty slot
+        uint32_t *keys() const { return reinterpret_cast<uint32_t *>(arena.at(offset)); }
+        T *values() const { return reinterpret_cast<T *>(arena.at(offset) + values_offset(capacity)); }
+
+        size_t home(size_t index) const { return (uint64_t(index) * 0x9E3779B97F4A7C15ull >> 32) & (capacity - 1); }
+
+        size_t find(size_t index) const
+        {
+            const uint32_t *keys = this->keys();
+            size_t slot = home(index);
+            while (keys[slot] != 0 && keys[slot] != index + 1)
+                slot = (slot + 1) & (capacity - 1);
+            return slot;
+        }
+
+        T get(size_t index) const
+        {
+            if (count == 0)
+                return fallback;
+
+            size_t slot = find(index);
+            return keys()[slot] != 0 ? values()[slot] : fallback;
+        }
+
+        void set(size_t index, T value)
+        {
+            if (count > 0)
+            {
+                size_t slot = find(index);
+                if (keys()[slot] != 0)
+                {
+                    if (value == fallback)
+                    {
+                        remove(slot);
+                    }
+                    else
+                    {
+                        record(values()[slot]);
+                        values()[slot] = value;
+                    }
+                    return;
+                }
+            }
+
+            if (value == fallback)
+                return;
+
+            if ((count + 1) * 4 > capacity * 3)
+                grow();
+
+            size_t slot = find(index);
+            record(count);
+            record(keys()[slot]);
+            record(values()[slot]);
+            keys()[slot] = (uint32_t)(index + 1);
+            values()[slot] = value;
+            count++;
+        }
+
+        // The entries are moved rather than the region being extended, and the old region is left
+        // as it was, so the journal only needs to restore where the table is
+        void grow()
+        {
+            record(capacity);
+            record(offset);
+            record(*arena.used);
+
+            const uint32_t *old_keys = capacity > 0 ? keys() : nullptr;
+            const T *old_values = capacity > 0 ? values() : nullptr;
+            size_t old_capacity = capacity;
+
+            size_t new_capacity = capacity == 0 ? Capacity : 2 * capacity;
+            offset = allocate(values_offset(new_capacity) + new_capacity * sizeof(T), std::max(alignof(uint32_t), alignof(T)));
+            capacity = (uint32_t)new_capacity;
+
+            uint32_t *keys = this->keys();
+            T *values = this->values();
+            std::memset(keys, 0, capacity * sizeof(uint32_t));
+            for (size_t i = 0; i < old_capacity; i++)
+            {
+                if (old_keys[i] == 0)
+                    continue;
+
+                size_t slot = home(old_keys[i] - 1);
+                while (keys[slot] != 0)
+                    slot = (slot + 1) & (capacity - 1);
+                keys[slot] = old_keys[i];
+                values[slot] = old_values[i];
+            }
+        }
+
+        void remove(size_t hole)
+        {
+            uint32_t *keys = this->keys();
+            T *values = this->values();
+            record(count);
+            record(keys[hole]);
+            for (size_t next = (hole + 1) & (capacity - 1); keys[next] != 0; next = (next + 1) & (capacity - 1))
+            {
+                // An entry can fill the hole if the hole is between its home slot and its slot
+                size_t from_home = (next - home(keys[next] - 1)) & (capacity - 1);
+                if (from_home >= ((next - hole) & (capacity - 1)))
+                {
+                    record(values[hole]);
+                    record(keys[next]);
+                    keys[hole] = keys[next];
+                    values[hole] = values[next];
+                    hole = next;
+                }
+            }
+
+            keys[hole] = 0;
+            count--;
+        }
+    };
+
+    // A list in the arena is restored by its region and elements, and by the space the arena has used.
+    // Regions are never reused, so the elements it moves to or appends are simply forgotten.
+    template <typename T>
+    void record(Buffer<T> &list)
+    {
+        if (!journal)
+            return;
+
+        journal->save(&list, sizeof(list));
+        journal->save(arena.used, sizeof(*arena.used));
+        journal->save(list.begin(), list.size() * sizeof(T));
+    }
+
+    // HASHING
+
+    // NOTE: The state keeps a Zobrist hash of its values, the XOR of a key for the value at every
+    //       location that is not the default value. Each write replaces the key of the old value
+    //       with the key of the new one, so the hash is always up to date and costs nothing to read.
+    //       Keys are computed from the location and value, rather than looked up in a table.
+
+    inline uint64_t mix(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    template <typename T>
+    uint64_t hash_value(const T &value)
+    {
+        if constexpr (std::is_same<T, double>::value)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        else if constexpr (std::is_same<T, const char *>::value)
+        {
+            // Strings are equal by value, so they are hashed by value
+            if (value == nullptr)
+                return 0;
+
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (const char *c = value; *c; c++)
+                hash = (hash ^ (unsigned char)*c) * 0x100000001B3ull;
+            return hash;
+        }
+        else
+        {
+            return uint64_t(value);
+        }
+    }
+
+    template <typename T, size_t N>
+    uint64_t hash_value(const List<T, N> &list)
+    {
+        uint64_t hash = list.count;
+        for (const auto &value : list)
+            hash = mix(hash ^ hash_value(value));
+        return hash;
+    }
+
+    template <typename T>
+    uint64_t hash_value(const Buffer<T> &list)
+    {
+        uint64_t hash = list.count;
+        for (const auto &value : list)
+            hash = mix(hash ^ hash_value(value));
+        return hash;
+    }
+
+    inline uint64_t zobrist_key(uint64_t key, size_t index, uint64_t value_hash)
+    {
+        return mix(mix((key << 32) ^ index) ^ value_hash);
+    }
+
+    // Each state property also has a hash of its own values, which memoised functions use to tell
+    // whether the state they read has changed
+
+    template <typename T, size_t N, typename V>
+    void assign(uint64_t &hash, uint64_t &property_hash, uint64_t key, T (&column)[N], size_t index, const V &value)
+    {
+        T new_value = value;
+        uint64_t change = zobrist_key(key, index, hash_value(column[index])) ^ zobrist_key(key, index, hash_value(new_value));
+        record(hash);
+        record(property_hash);
+        record(column[index]);
+        hash ^= change;
+        property_hash ^= change;
+        column[index] = new_value;
+    }
+
+    template <typename T, unsigned Bits, size_t N, typename V>
+    void assign(uint64_t &hash, uint64_t &property_hash, uint64_t key, Packed<T, Bits, N> &column, size_t index, const V &value)
+    {
+        T new_value = value;
+        uint64_t change = zobrist_key(key, index, hash_value(column.get(index))) ^ zobrist_key(key, index, hash_value(new_value));
+        record(hash);
+        record(property_hash);
+        record(column.words[index / column.per_word]);
+        hash ^= change;
+        property_hash ^= change;
+        column.set(index, new_value);
+    }
+
+    template <typename T, size_t Capacity, typename V>
+    void assign(uint64_t &hash, uint64_t &property_hash, uint64_t key, Sparse<T, Capacity> &table, size_t index, const V &value)
+    {
+        T new_value = value;
+        uint64_t change = zobrist_key(key, index, hash_value(table.get(index))) ^ zobrist_key(key, index, hash_value(new_value));
+        record(hash);
+        record(property_hash);
+        hash ^= change;
+        property_hash ^= change;
+        table.set(index, new_value);
+    }
+
+    template <typename T, unsigned Bits, size_t N, typename V, size_t Values>
+    void assign(uint64_t &hash, uint64_t &property_hash, uint64_t key, Packed<T, Bits, N> &column, size_t index, const V &value, ReverseIndex<Values, N> &reverse_index)
+    {
+        size_t old_value = (size_t)column.get(index);
+        assign(hash, property_hash, key, column, index, value);
+        reverse_index.update(index, old_value, (size_t)column.get(index));
+    }
+
+    // Lists in the arena keep their region when they are assigned a list that fits in it
+    template <typename T, size_t N, typename V>
+    void assign(uint64_t &hash, uint64_t &property_hash, uint64_t key, Buffer<T> (&column)[N], size_t index, const V &value)
+    {
+        uint64_t change = zobrist_key(key, index, hash_value(column[index]));
+        record(hash);
+        record(property_hash);
+        record(column[index]);
+        column[index].assign(value);
+        change ^= zobrist_key(key, index, hash_value(column[index]));
+        hash ^= change;
+        property_hash ^= change;
+    }
+
+    template <typename T, size_t N, typename Modify>
+    void modify(uint64_t &hash, uint64_t &property_hash, uint64_t key, T (&column)[N], size_t index, Modify modification)
+    {
+        uint64_t change = zobrist_key(key, index, hash_value(column[index]));
+        record(hash);
+        record(property_hash);
+        record(column[index]);
+        modification(column[index]);
+        change ^= zobrist_key(key, index, hash_value(column[index]));
+        hash ^= change;
+        property_hash ^= change;
+    }
+
+    // Creates an entity, which is counted in the hash so that the same values with more entities hash differently
+    inline uint32_t increment(uint64_t &hash, uint64_t key, uint32_t &count)
+    {
+        record(hash);
+        record(count);
+        hash ^= zobrist_key(key, 0, count) ^ zobrist_key(key, 0, count + 1);
+        return ++count;
+    }
+
+    // MEMOISATION
+
+    // The result of a memoised function, and the hash of the state it read when it was computed
+    template <typename T>
+    struct Cache
+    {
+        uint64_t stamp;
+        bool valid;
+        T value;
+    };
+
+    // Reports how quickly the game state can be cloned, which bounds how quickly a search can explore the game.
+    // The state is cloned before the game starts, when its arena has no overflow, so only the block is copied.
+    template <typename State>
+    void benchmark_clone(const State &state)
+    {
+        static_assert(std::is_trivially_copyable<State>::value, "The game state must be cloned with memcpy");
+
+        constexpr size_t clones = 10000000;
+        std::vector<State> copies(2);
+
+        // Called through a volatile pointer, so that the copies are not optimised away
+        void *(*volatile copy)(void *, const void *, size_t) = std::memcpy;
+
+        auto start = std::chrono::steady_clock::now();
+        copy(&copies[0], &state, sizeof(State));
+        for (size_t i = 1; i < clones; i++)
+            copy(&copies[i % 2], &copies[(i + 1) % 2], sizeof(State));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "State size: " << sizeof(State) << " bytes" << std::endl;
+        std::cout << "Clones per second: " << (size_t)(clones / elapsed.count()) << std::endl;
+    }
+
+    // VALUES
+
+    // NOTE: Lists are indexed from 1
+    template <typename T>
+    T &at(std::vector<T> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    template <typename T>
+    const T &at(const std::vector<T> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    inline std::vector<bool>::reference at(std::vector<bool> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    inline bool at(const std::vector<bool> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    template <typename T, size_t N>
+    T &at(List<T, N> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    template <typename T, size_t N>
+    const T &at(const List<T, N> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    template <typename T>
+    T &at(Buffer<T> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    template <typename T>
+    const T &at(const Buffer<T> &list, int32_t index)
+    {
+        if (index < 1 || (size_t)index > list.size())
+            error("List index out of range.");
+        return list[index - 1];
+    }
+
+    // The value of a match expression where no rule matched
+    template <typename T>
+    T no_match()
+    {
+        error("No rule of the match expression matched the value.");
+    }
+
+    template <typename T>
+    bool equal(const T &a, const T &b)
+    {
+        return a == b;
+    }
+
+    // Strings are compared by value, and `none` is a null pointer
+    inline bool equal(const char *a, const char *b)
+    {
+        if (a == nullptr || b == nullptr)
+            return a == b;
+        return std::strcmp(a, b) == 0;
+    }
+
+    inline std::string describe(const char *value) { return value ? value : "none"; }
+    inline std::string describe(bool value) { return value ? "true" : "false"; }
+    inline std::string describe(int32_t value) { return std::to_string(value); }
+    inline std::string describe(double value) { return std::to_string(value); }
+
+    // RANDOMNESS
+
+    // NOTE: A xoshiro256** generator. Its state is filled from the seed with `mix`, so that any seed,
+    //       including 0, gives a well mixed state, and nearby seeds give unrelated streams.
+    struct Random
+    {
+        uint64_t s[4];
+
+        Random(uint64_t seed = 0) { this->seed(seed); }
+
+        void seed(uint64_t seed)
+        {
+            for (auto &word : s)
+                word = seed = mix(seed);
+        }
+
+        uint64_t next()
+        {
+            uint64_t result = rotate(s[1] * 5, 7) * 9;
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotate(s[3], 45);
+            return result;
+        }
+
+        // An integer below `bound` with no modulo bias, by Lemire's multiply and reject method.
+        // Only the rare values that would be biased are drawn again, so there is usually no division.
+        uint32_t below(uint32_t bound)
+        {
+            uint64_t product = (next() >> 32) * bound;
+            uint32_t low = (uint32_t)product;
+            if (low < bound)
+            {
+                uint32_t threshold = (0u - bound) % bound;
+                while (low < threshold)
+                {
+                    product = (next() >> 32) * bound;
+                    low = (uint32_t)product;
+                }
+            }
+            return (uint32_t)(product >> 32);
+        }
+
+    private:
+        static uint64_t rotate(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    };
+
+    // The randomness of the game itself, such as shuffling. Every play of the game reseeds it with the
+    // same seed, so that the game is repeated exactly when its choices are.
+    inline thread_local Random game_random;
+
+    // Shuffles a list in place with the Fisher-Yates method
+    template <typename T, typename Values>
+    void shuffle_values(Values &values)
+    {
+        for (size_t i = values.size(); i > 1; i--)
+        {
+            size_t j = game_random.below((uint32_t)i);
+            T value = values[i - 1];
+            values[i - 1] = values[j];
+            values[j] = value;
+        }
+    }
+
+    template <typename T>
+    void shuffle(std::vector<T> &values) { shuffle_values<T>(values); }
+
+    template <typename T, size_t N>
+    void shuffle(List<T, N> &values) { shuffle_values<T>(values); }
+
+    template <typename T>
+    void shuffle(Buffer<T> &values) { shuffle_values<T>(values); }
+
+    // CHOICES
+
+    // NOTE: Every `choose` in the game is made by the current chooser of the thread. When there is
+    //       no chooser, the choice is made by a person at the terminal.
+    struct Chooser
+    {
+        virtual ~Chooser() = default;
+        virtual size_t choose(uint32_t player, const char *prompt, size_t count, const std::function<std::string(size_t)> &describe) = 0;
+    };
+
+    inline thread_local Chooser *chooser = nullptr;
+
+    inline size_t ask(uint32_t player, const char *prompt, size_t count, const std::function<std::string(size_t)> &describe)
+    {
+        while (true)
+        {
+            std::cout << "Player " << player << ": " << prompt << std::endl;
+            for (size_t i = 0; i < count; i++)
+                std::cout << "  " << (i + 1) << ". " << describe(i) << std::endl;
+
+            size_t choice;
+            if (!(std::cin >> choice))
+            {
+                if (std::cin.eof())
+                    error("No choice was made.");
+
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                continue;
+            }
+
+            if (choice >= 1 && choice <= count)
+                return choice - 1;
+        }
+    }
+
+    // Lists are chosen from in place, so that choosing from a list of state or a bounded list does not copy it
+    template <typename T, typename Choices, typename Describe>
+    T choose_from(uint32_t player, const char *prompt, const Choices &choices, Describe describe)
+    {
+        if (choices.size() == 0)
+            error("There are no choices to choose from.");
+
+        auto describe_choice = [&](size_t i)
+        { return describe(choices[i]); };
+
+        size_t index = chooser ? chooser->choose(player, prompt, choices.size(), describe_choice)
+                               : ask(player, prompt, choices.size(), describe_choice);
+        return choices[index];
+    }
+
+    template <typename T, typename Describe>
+    T choose(uint32_t player, const char *prompt, const std::vector<T> &choices, Describe describe)
+    {
+        return choose_from<T>(player, prompt, choices, describe);
+    }
+
+    template <typename T, size_t N, typename Describe>
+    T choose(uint32_t player, const char *prompt, const List<T, N> &choices, Describe describe)
+    {
+        return choose_from<T>(player, prompt, choices, describe);
+    }
+
+    template <typename T, typename Describe>
+    T choose(uint32_t player, const char *prompt, const Buffer<T> &choices, Describe describe)
+    {
+        return choose_from<T>(player, prompt, choices, describe);
+    }
+
+    // COMBINATIONS
+
+    // NOTE: The options of `choose[k]` are the combinations of k different positions in the choices,
+    //       in lexicographic order. An option is found from its index only once it is chosen or
+    //       described, so a chooser such as the search can expand a choice from the number of
+    //       options alone, without the combinations ever being listed.
+
+    inline size_t binomial(size_t n, size_t k)
+    {
+        if (k > n)
+            return 0;
+        k = std::min(k, n - k);
+
+        // Each partial product is itself a binomial coefficient, so the division is exact
+        size_t result = 1;
+        for (size_t i = 0; i < k; i++)
+        {
+            if (result > std::numeric_limits<size_t>::max() / (n - i))
+                error("There are too many combinations to choose from.");
+            result = result * (n - i) / (i + 1);
+        }
+        return result;
+    }
+
+    struct Combinations
+    {
+        size_t n;
+        size_t k;
+
+        size_t size() const { return binomial(n, k); }
+
+        // The increasing positions of the combination with an index
+        void unrank(size_t index, size_t *positions) const
+        {
+            size_t position = 0;
+            for (size_t i = 0; i < k; i++)
+            {
+                // Skip past the combinations that take each earlier position next
+                for (size_t skipped; index >= (skipped = binomial(n - position - 1, k - i - 1)); position++)
+                    index -= skipped;
+                positions[i] = position++;
+            }
+        }
+
+        void first(size_t *positions) const
+        {
+            for (size_t i = 0; i < k; i++)
+                positions[i] = i;
+        }
+
+        // Moves to the combination after the positions, or returns false if they were the last one
+        bool next(size_t *positions) const
+        {
+            size_t i = k;
+            while (i > 0 && positions[i - 1] == n - k + (i - 1))
+                i--;
+            if (i == 0)
+                return false;
+
+            positions[i - 1]++;
+            for (size_t j = i; j < k; j++)
+                positions[j] = positions[j - 1] + 1;
+            return true;
+        }
+    };
+
+    template <size_t K, typename T, typename Choices, typename Describe>
+    List<T, K> choose_combination_from(uint32_t player, const char *prompt, const Choices &choices, Describe describe)
+    {
+        Combinations combinations{choices.size(), K};
+        size_t count = combinations.size();
+        if (count == 0)
+            error("There are not enough choices to choose from.");
+
+        auto describe_combination = [&](size_t i)
+        {
+            size_t positions[K];
+            combinations.unrank(i, positions);
+
+            std::string description;
+            for (size_t j = 0; j < K; j++)
+                description += (j > 0 ? ", " : "") + describe(choices[positions[j]]);
+            return description;
+        };
+
+        size_t index = chooser ? chooser->choose(player, prompt, count, describe_combination)
+                               : ask(player, prompt, count, describe_combination);
+
+        size_t positions[K];
+        combinations.unrank(index, positions);
+
+        List<T, K> chosen;
+        chosen.count = 0;
+        for (size_t j = 0; j < K; j++)
+            chosen.push_back(choices[positions[j]]);
+        return chosen;
+    }
+
+    template <size_t K, typename T, typename Describe>
+    List<T, K> choose_combination(uint32_t player, const char *prompt, const std::vector<T> &choices, Describe describe)
+    {
+        return choose_combination_from<K, T>(player, prompt, choices, describe);
+    }
+
+    template <size_t K, typename T, size_t N, typename Describe>
+    List<T, K> choose_combination(uint32_t player, const char *prompt, const List<T, N> &choices, Describe describe)
+    {
+        return choose_combination_from<K, T>(player, prompt, choices, describe);
+    }
+
+    template <size_t K, typename T, typename Describe>
+    List<T, K> choose_combination(uint32_t player, const char *prompt, const Buffer<T> &choices, Describe describe)
+    {
+        return choose_combination_from<K, T>(player, prompt, choices, describe);
+    }
+}
+
+#endif
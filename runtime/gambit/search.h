@@ -0,0 +1,612 @@
+/*
+search.h
+
+A Monte-Carlo Tree Search player for the programs generated by the Gambit compiler, and the
+entry point that lets each player of a game be a person, the search or a simple policy, and that
+can play many games headless to measure how often each player wins.
+
+Every `choose` in a game is a node of the search tree. The game state cannot be resumed part way
+through the program, so each simulation plays the game again from the start: the choices made so
+far are replayed, then the tree is walked, then the rest of the game is played out at random.
+
+Every play of the game reseeds the game's own randomness with the seed of the game, so that the
+replayed choices reach the same state. The random choices of each simulation come from a stream of
+their own, derived from the seed and the number of the simulation rather than from the thread that
+runs it. A simulation makes the same random choices on any number of threads, and a search on one
+thread with the same seed is repeated exactly.
+
+A search can also play as one of the players, seeing only what they can see (Information Set MCTS).
+Each simulation replays the game as before, then samples the state the player cannot see when it
+reaches the choice being made: the hidden state of the other players is dealt out again, and the
+game's randomness is reseeded, so that the rest of the game is a possible future rather than the
+real one. The simulations share one tree of the player's choices, in which each node stands for
+every sampled game that reached it by the same choices.
+*/
+
+#pragma once
+#ifndef GAMBIT_SEARCH_H
+#define GAMBIT_SEARCH_H
+
+#include "minimax.h"
+#include "runtime.h"
+#include "transposition.h"
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace gambit
+{
+    struct SearchOptions
+    {
+        size_t iterations = 10000;
+        size_t time_ms = 0; // No limit when 0
+        size_t threads = 0; // Every core when 0
+
+        // Simulations that make more choices than this are scored as a draw
+        size_t rollout_limit = 100000;
+        double exploration = 1.41421356237;
+
+        uint64_t seed = 0; // The seed of the game's randomness, and of the search's
+    };
+
+    // NOTE: Nodes are shared between the search threads. Statistics are updated atomically, and
+    //       the children of a node are created once, under its lock.
+    struct SearchNode
+    {
+        std::atomic<uint32_t> visits{0};
+        std::atomic<uint32_t> virtual_loss{0};
+        std::atomic<uint64_t> score{0}; // In half points, for the player that chose this node
+
+        std::mutex expand_lock;
+        std::atomic<bool> expanded{false};
+        uint32_t player = 0; // The player that chooses between the children
+        size_t child_count = 0;
+        std::unique_ptr<SearchNode[]> children;
+
+        void expand(uint32_t choosing_player, size_t count)
+        {
+            std::lock_guard<std::mutex> lock(expand_lock);
+            if (expanded.load(std::memory_order_relaxed))
+                return;
+
+            player = choosing_player;
+            child_count = count;
+            children.reset(new SearchNode[count]);
+            expanded.store(true, std::memory_order_release);
+        }
+    };
+
+    struct RolloutLimit
+    {
+    };
+
+    class Search
+    {
+    public:
+        // NOTE: The observer is the player the search only sees as, or 0 when it sees the whole game.
+        //       The determinise function samples the state hidden from the observer, and is only
+        //       given for games with hidden state.
+        Search(void (*play)(), const std::vector<size_t> &history, const SearchOptions &options, uint32_t observer = 0, void (*determinise)(uint32_t) = nullptr)
+            : play(play), history(history), options(options), observer(observer), determinise(determinise) {}
+
+        size_t run()
+        {
+            size_t thread_count = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+            start = std::chrono::steady_clock::now();
+
+            // The game being played has its state on this thread, so simulations are only run on the
+            // search threads, which each have their own state.
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < thread_count; i++)
+                threads.emplace_back([this, i]
+                                     { work(i); });
+            for (auto &thread : threads)
+                thread.join();
+
+            // The most visited choice is the most robust
+            if (!root.expanded.load(std::memory_order_acquire))
+                return 0;
+
+            size_t best = 0;
+            for (size_t i = 1; i < root.child_count; i++)
+                if (root.children[i].visits.load() > root.children[best].visits.load())
+                    best = i;
+            return best;
+        }
+
+        size_t simulations() const { return completed.load(); }
+
+    private:
+        void (*play)();
+        const std::vector<size_t> &history;
+        SearchOptions options;
+        uint32_t observer;
+        void (*determinise)(uint32_t);
+
+        SearchNode root;
+        std::atomic<size_t> claimed{0};
+        std::atomic<size_t> completed{0};
+        std::chrono::steady_clock::time_point start;
+
+        bool out_of_time() const
+        {
+            if (options.time_ms == 0)
+                return false;
+            return std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(options.time_ms);
+        }
+
+        struct Step
+        {
+            SearchNode *node;
+            uint32_t player; // The player that chose the node
+        };
+
+        struct Simulation : Chooser
+        {
+            Search &search;
+            Random random;
+            std::vector<Step> path;
+            SearchNode *current;
+            size_t depth = 0;
+            size_t rollout_choices = 0;
+            bool in_tree = true;
+
+            Simulation(Search &search, uint64_t seed) : search(search), random(seed), current(&search.root) {}
+
+            size_t choose(uint32_t player, const char *, size_t count, const std::function<std::string(size_t)> &) override
+            {
+                // Replay the choices that have already been made in the game
+                if (depth < search.history.size())
+                    return search.history[depth++];
+
+                // Only the state the observer can see is kept from the game being played
+                if (depth == search.history.size() && search.observer != 0)
+                {
+                    game_random.seed(random.next());
+                    if (search.determinise)
+                        search.determinise(search.observer);
+                }
+                depth++;
+
+                if (!in_tree)
+                {
+                    if (++rollout_choices > search.options.rollout_limit)
+                        throw RolloutLimit();
+                    return random.below((uint32_t)count);
+                }
+
+                if (!current->expanded.load(std::memory_order_acquire))
+                    current->expand(player, count);
+
+                // The game is deterministic apart from its choices, so the same node always has the same
+                // choices. Sampled games can differ, so those with more choices leave the tree, and those
+                // with fewer only select between the choices they have.
+                if (current->child_count != count)
+                {
+                    if (search.observer == 0)
+                        error("The search reached the same choice with a different number of options.");
+                    if (count > current->child_count)
+                    {
+                        in_tree = false;
+                        return random.below((uint32_t)count);
+                    }
+                }
+
+                size_t index = select(*current, count);
+                SearchNode *child = &current->children[index];
+                child->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+                path.push_back({child, player});
+
+                // The simulation leaves the tree at the first node that has not been visited
+                if (child->visits.load(std::memory_order_relaxed) == 0)
+                    in_tree = false;
+                current = child;
+                return index;
+            }
+
+            size_t select(SearchNode &node, size_t count)
+            {
+                double parent_visits = node.visits.load(std::memory_order_relaxed) + node.virtual_loss.load(std::memory_order_relaxed);
+                double log_visits = std::log(std::max(1.0, parent_visits));
+
+                size_t best = 0;
+                double best_value = -1;
+                for (size_t i = 0; i < std::min(count, node.child_count); i++)
+                {
+                    auto &child = node.children[i];
+
+                    // Pending simulations count as losses, so that threads spread out over the tree
+                    double visits = child.visits.load(std::memory_order_relaxed) + child.virtual_loss.load(std::memory_order_relaxed);
+                    if (visits == 0)
+                        return i;
+
+                    double mean = child.score.load(std::memory_order_relaxed) / 2.0 / visits;
+                    double value = mean + search.options.exploration * std::sqrt(log_visits / visits);
+                    if (value > best_value)
+                    {
+                        best = i;
+                        best_value = value;
+                    }
+                }
+                return best;
+            }
+        };
+
+        void work(size_t)
+        {
+            // Each search has its own streams, as it starts from a different number of choices
+            uint64_t search_seed = mix(options.seed ^ mix(history.size()));
+
+            // Each simulation undoes the writes of the last one, rather than clearing the whole state
+            Journal undo;
+            journal = &undo;
+
+            size_t index;
+            while ((index = claimed.fetch_add(1)) < options.iterations && !out_of_time())
+            {
+                Simulation simulation(*this, mix(search_seed ^ index));
+                chooser = &simulation;
+                game_random.seed(options.seed);
+
+                // Games that end without a result are a draw
+                uint32_t winner = 0;
+                try
+                {
+                    play();
+                }
+                catch (const GameOver &result)
+                {
+                    winner = result.winner;
+                }
+                catch (const RolloutLimit &)
+                {
+                }
+
+                chooser = nullptr;
+
+                root.visits.fetch_add(1, std::memory_order_relaxed);
+                for (auto &step : simulation.path)
+                {
+                    uint64_t half_points = winner == step.player ? 2 : winner == 0 ? 1
+                                                                                   : 0;
+                    step.node->score.fetch_add(half_points, std::memory_order_relaxed);
+                    step.node->visits.fetch_add(1, std::memory_order_relaxed);
+                    step.node->virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                completed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            journal = nullptr;
+        }
+    };
+
+    // PLAYING
+
+    // How the choices of a player are made
+    struct Policy
+    {
+        enum Kind
+        {
+            PERSON, // At the terminal
+            RANDOM,
+            FIRST,
+            SCRIPT, // The choices of the script in turn, then the first
+            SEARCH,
+            INFORMATION_SET, // A search that only sees what the player can see
+            MINIMAX,
+        };
+
+        Kind kind = PERSON;
+        std::vector<size_t> script;
+    };
+
+    // Makes the choices of the game being played. The choices of players controlled by the search
+    // are made by searching from the choices that have been made so far.
+    struct GameChooser : Chooser
+    {
+        void (*play)();
+        uint64_t (*hash)() = nullptr;
+        double (*evaluate)(uint32_t) = nullptr; // The evaluation function of the game, if it has one
+        void (*determinise)(uint32_t) = nullptr; // Samples the state hidden from a player, if the game has any
+        std::vector<Policy> policies;
+        SearchOptions options;
+        size_t depth = 64; // The most choices the alpha-beta search looks ahead
+        std::vector<size_t> history;
+        std::shared_ptr<TranspositionTable> table; // Of the alpha-beta search, which is created when it is first used
+
+        // NOTE: When headless, no one is at the terminal. Players without a policy choose at random,
+        //       nothing is reported, and games that make too many choices are abandoned.
+        bool headless = false;
+        Random random;
+        std::vector<size_t> script_positions;
+        uint32_t players = 0; // The highest player that has made a choice
+
+        // Starts a new game, keeping the memory of the last one
+        void reset(uint64_t seed)
+        {
+            options.seed = seed;
+            game_random.seed(seed);
+            random.seed(mix(seed));
+            history.clear();
+            if (table)
+                table->clear();
+            script_positions.assign(policies.size(), 0);
+        }
+
+        size_t choose(uint32_t player, const char *prompt, size_t count, const std::function<std::string(size_t)> &describe) override
+        {
+            if (headless && history.size() >= options.rollout_limit)
+                throw RolloutLimit();
+            players = std::max(players, player);
+
+            Policy::Kind kind = player < policies.size() ? policies[player].kind : Policy::PERSON;
+            if (headless && kind == Policy::PERSON)
+                kind = Policy::RANDOM;
+
+            size_t index = 0;
+            switch (kind)
+            {
+            case Policy::PERSON:
+                index = ask(player, prompt, count, describe);
+                break;
+
+            case Policy::RANDOM:
+                index = random.below((uint32_t)count);
+                break;
+
+            case Policy::FIRST:
+                break;
+
+            case Policy::SCRIPT:
+            {
+                auto &script = policies[player].script;
+                auto &position = script_positions[player];
+                if (position < script.size())
+                    index = script[position++];
+                if (index >= count)
+                    error("A scripted choice is not one of the options.");
+                break;
+            }
+
+            case Policy::SEARCH:
+            case Policy::INFORMATION_SET:
+            {
+                Search search(play, history, options, kind == Policy::INFORMATION_SET ? player : 0, determinise);
+                index = search.run();
+
+                if (!headless)
+                    std::cout << "Player " << player << " chooses " << describe(index)
+                              << " (" << search.simulations() << " simulations)" << std::endl;
+                break;
+            }
+
+            case Policy::MINIMAX:
+            {
+                MinimaxOptions minimax_options;
+                minimax_options.depth = depth;
+                minimax_options.time_ms = options.time_ms;
+                minimax_options.threads = options.threads;
+                minimax_options.seed = options.seed;
+
+                if (!table)
+                    table = std::make_shared<TranspositionTable>(1 << 20);
+
+                Minimax search(play, hash, evaluate, history, minimax_options, *table);
+                index = search.run();
+
+                if (!headless)
+                    std::cout << "Player " << player << " chooses " << describe(index)
+                              << " (depth " << search.depth() << ", " << search.nodes() << " nodes, "
+                              << (size_t)(search.nodes() / std::max(search.seconds(), 1e-9)) << " nodes per second)" << std::endl;
+                break;
+            }
+            }
+
+            history.push_back(index);
+            return index;
+        }
+    };
+
+    // SELF-PLAY
+
+    // NOTE: Plays many games without anyone at the terminal, spread over the threads. Each thread
+    //       plays its games on its own game state, which is reset rather than reallocated for each
+    //       game. A search makes each choice on a single thread, as the games are already parallel.
+    //       Each game is seeded from the seed and its number, so the results do not depend on the
+    //       number of threads.
+    inline void self_play(const GameChooser &settings, size_t games)
+    {
+        size_t thread_count = settings.options.threads > 0 ? settings.options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+        std::atomic<size_t> next{0};
+        std::mutex results_lock;
+        std::vector<size_t> results; // The games won by each player, with draws at 0
+        size_t unfinished = 0;
+        uint32_t players = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; t++)
+            threads.emplace_back([&]
+                                 {
+                GameChooser game = settings;
+                game.headless = true;
+                game.options.threads = 1;
+
+                std::vector<size_t> thread_results;
+                size_t thread_unfinished = 0;
+                Journal undo;
+                journal = &undo;
+                chooser = &game;
+
+                size_t index;
+                while ((index = next.fetch_add(1)) < games)
+                {
+                    game.reset(mix(settings.options.seed ^ mix(index)));
+
+                    // Games that end without a result are a draw
+                    uint32_t winner = 0;
+                    try
+                    {
+                        game.play();
+                    }
+                    catch (const GameOver &result)
+                    {
+                        winner = result.winner;
+                    }
+                    catch (const RolloutLimit &)
+                    {
+                        thread_unfinished++;
+                        continue;
+                    }
+
+                    if (thread_results.size() <= winner)
+                        thread_results.resize(winner + 1);
+                    thread_results[winner]++;
+                }
+
+                chooser = nullptr;
+                journal = nullptr;
+
+                std::lock_guard<std::mutex> lock(results_lock);
+                if (results.size() < thread_results.size())
+                    results.resize(thread_results.size());
+                for (size_t i = 0; i < thread_results.size(); i++)
+                    results[i] += thread_results[i];
+                unfinished += thread_unfinished;
+                players = std::max(players, game.players); });
+        for (auto &thread : threads)
+            thread.join();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.resize(std::max<size_t>(results.size(), players + 1));
+        players = (uint32_t)results.size() - 1;
+
+        auto percent = [&](size_t count)
+        { return games > 0 ? 100.0 * count / games : 0.0; };
+
+        std::cout << "Played " << games << " games in " << seconds << " seconds ("
+                  << (seconds > 0 ? games / seconds : 0.0) << " games per second)" << std::endl;
+        for (uint32_t player = 1; player <= players; player++)
+            std::cout << "Player " << player << " wins " << results[player] << " (" << percent(results[player]) << "%)" << std::endl;
+        std::cout << "Draws " << results[0] << " (" << percent(results[0]) << "%)" << std::endl;
+        if (unfinished > 0)
+            std::cout << "Unfinished " << unfinished << " (" << percent(unfinished) << "%)" << std::endl;
+    }
+
+    // USAGE: <game> [--ai PLAYER]... [--ismcts PLAYER]... [--minimax PLAYER]... [--random PLAYER]... [--first PLAYER]... [--script PLAYER CHOICES]...
+    //               [--iterations N] [--depth N] [--time MS] [--threads N] [--seed N] [--games N] [--benchmark-clone]
+    // NOTE: The choices of a script are separated by commas, and numbered from 1 as at the terminal.
+    //       With `--games`, the games are played headless, and the results reported.
+    // NOTE: Without a seed, the game is seeded at random and the seed is reported, so that it can be replayed
+    template <typename State>
+    int run(int argc, char **argv, const State &state, void (*play)(), uint64_t (*hash)(), double (*evaluate)(uint32_t), void (*determinise)(uint32_t))
+    {
+        GameChooser game;
+        game.play = play;
+        game.hash = hash;
+        game.evaluate = evaluate;
+        game.determinise = determinise;
+        bool seeded = false;
+        size_t games = 0;
+
+        for (int i = 1; i < argc; i++)
+        {
+            std::string flag = argv[i];
+            if (flag == "--benchmark-clone")
+            {
+                benchmark_clone(state);
+                return 0;
+            }
+
+            if (i + 1 >= argc)
+                error(("Expected a value after " + flag).c_str());
+            uint64_t value = std::strtoull(argv[++i], nullptr, 10);
+
+            auto policy = [&]() -> Policy &
+            {
+                if (game.policies.size() <= value)
+                    game.policies.resize(value + 1);
+                return game.policies[value];
+            };
+
+            if (flag == "--ai")
+                policy().kind = Policy::SEARCH;
+            else if (flag == "--ismcts")
+                policy().kind = Policy::INFORMATION_SET;
+            else if (flag == "--minimax")
+                policy().kind = Policy::MINIMAX;
+            else if (flag == "--random")
+                policy().kind = Policy::RANDOM;
+            else if (flag == "--first")
+                policy().kind = Policy::FIRST;
+            else if (flag == "--script")
+            {
+                if (i + 1 >= argc)
+                    error("Expected the choices of the script after --script PLAYER");
+
+                auto &scripted = policy();
+                scripted.kind = Policy::SCRIPT;
+                scripted.script.clear();
+                for (char *choices = argv[++i]; *choices;)
+                {
+                    size_t choice = std::strtoull(choices, &choices, 10);
+                    if (choice == 0)
+                        error("The choices of a script are numbered from 1.");
+                    scripted.script.push_back(choice - 1);
+                    if (*choices == ',')
+                        choices++;
+                }
+            }
+            else if (flag == "--iterations")
+                game.options.iterations = value;
+            else if (flag == "--depth")
+                game.depth = value;
+            else if (flag == "--time")
+                game.options.time_ms = value;
+            else if (flag == "--threads")
+                game.options.threads = value;
+            else if (flag == "--seed")
+            {
+                game.options.seed = value;
+                seeded = true;
+            }
+            else if (flag == "--games")
+                games = value;
+            else
+                error(("Unknown option " + flag).c_str());
+        }
+
+        if (!seeded)
+        {
+            std::random_device device;
+            game.options.seed = ((uint64_t)device() << 32) ^ device();
+            std::cout << "Seed " << game.options.seed << std::endl;
+        }
+
+        if (games > 0)
+        {
+            self_play(game, games);
+            return 0;
+        }
+
+        chooser = &game;
+        game.reset(game.options.seed);
+        try
+        {
+            play();
+        }
+        catch (const GameOver &result)
+        {
+            report(result);
+        }
+        chooser = nullptr;
+        return 0;
+    }
+}
+
+#endif
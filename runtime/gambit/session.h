@@ -0,0 +1,182 @@
+/*
+session.h
+
+Games that pause when they need a choice and are resumed later with the answer, so that one thread
+can keep many games in flight at once, such as a server with a game for each of its players.
+
+The generated program plays a game as straight-line code that waits at each `choose`. Rather than
+a thread for each game, each session runs the game on a small stack of its own, and switches back
+to the thread's stack whenever the game needs a choice. Every session on a thread shares the game
+state of the thread, so a paused session keeps a copy of the state, which it copies back to resume.
+The copy includes the overflow of the state's arena, which also belongs to the thread.
+
+A host includes the generated program with GAMBIT_NO_MAIN defined, then drives sessions of
+`gambit_play` on `gambit_state`.
+*/
+
+#pragma once
+#ifndef GAMBIT_SESSION_H
+#define GAMBIT_SESSION_H
+
+#include "runtime.h"
+#include <memory>
+
+#ifdef _WIN32
+#error "Sessions are not yet implemented on Windows."
+#endif
+#include <ucontext.h>
+
+namespace gambit
+{
+    // Thrown into a paused game to unwind it when its session is destroyed
+    struct SessionAbandoned
+    {
+    };
+
+    // NOTE: A session must always be resumed on the thread that started it, as the game state and
+    //       the memoised results of the game belong to the thread. Sessions refer to their own stack
+    //       from the context they switch to, so they cannot be copied or moved.
+    template <typename State>
+    class Session : Chooser
+    {
+    public:
+        Session(State &state, void (*play)(), uint64_t seed, size_t stack_size = 64 * 1024)
+            : live(state), play(play), saved(new Clone<State>()), random(seed), stack(new char[stack_size]), stack_size(stack_size) {}
+
+        Session(const Session &) = delete;
+        Session &operator=(const Session &) = delete;
+
+        ~Session()
+        {
+            if (started && !finished)
+            {
+                abandoning = true;
+                switch_in();
+            }
+        }
+
+        // Plays the game until it needs the first choice, or is over
+        void start()
+        {
+            if (started)
+                error("The session has already started.");
+
+            getcontext(&game_context);
+            game_context.uc_stack.ss_sp = stack.get();
+            game_context.uc_stack.ss_size = stack_size;
+            game_context.uc_link = &caller_context;
+
+            uintptr_t address = (uintptr_t)this;
+            makecontext(&game_context, (void (*)())enter, 2, (unsigned)(address >> 32), (unsigned)address);
+
+            started = true;
+            switch_in();
+        }
+
+        // Answers the choice the game is waiting for, and plays it until the next choice
+        void resume(size_t option)
+        {
+            if (!waiting())
+                error("The session is not waiting for a choice.");
+            if (option >= pending.count)
+                error("The option is not one of the choices.");
+
+            answer = option;
+            choices.push_back(option);
+            switch_in();
+        }
+
+        bool waiting() const { return started && !finished; }
+        bool over() const { return finished; }
+        uint32_t winner() const { return result; } // 0 if the game was a draw
+
+        // The choice the game is waiting for
+        uint32_t player() const { return pending.player; }
+        const char *prompt() const { return pending.prompt; }
+        size_t count() const { return pending.count; }
+
+        // The choices may be part of the state, so they are described with the state of the session
+        std::string describe(size_t option)
+        {
+            restore(live, *saved);
+            return (*pending.describe)(option);
+        }
+
+        // The choices made so far, from which the search can play the game again
+        const std::vector<size_t> &history() const { return choices; }
+
+    private:
+        State &live;
+        void (*play)();
+        std::unique_ptr<Clone<State>> saved;
+        Random random; // The game's randomness, while it is paused
+
+        std::unique_ptr<char[]> stack;
+        size_t stack_size;
+        ucontext_t game_context;
+        ucontext_t caller_context;
+        Chooser *caller_chooser = nullptr;
+
+        bool started = false;
+        bool finished = false;
+        bool abandoning = false;
+        uint32_t result = 0;
+
+        struct Pending
+        {
+            uint32_t player = 0;
+            const char *prompt = nullptr;
+            size_t count = 0;
+            const std::function<std::string(size_t)> *describe = nullptr;
+        };
+        Pending pending;
+        size_t answer = 0;
+        std::vector<size_t> choices;
+
+        // The context can only be given integers, so the session is passed in two halves
+        static void enter(unsigned high, unsigned low)
+        {
+            auto session = (Session *)(((uintptr_t)high << 32) | low);
+
+            // Games that end without a result are a draw
+            try
+            {
+                session->play();
+            }
+            catch (const GameOver &game_over)
+            {
+                session->result = game_over.winner;
+            }
+            catch (const SessionAbandoned &)
+            {
+            }
+            session->finished = true;
+        }
+
+        void switch_in()
+        {
+            restore(live, *saved);
+            std::swap(game_random, random);
+            caller_chooser = chooser;
+            chooser = this;
+
+            swapcontext(&caller_context, &game_context);
+
+            chooser = caller_chooser;
+            std::swap(game_random, random);
+            clone(*saved, live);
+        }
+
+        size_t choose(uint32_t player, const char *prompt, size_t count, const std::function<std::string(size_t)> &describe) override
+        {
+            pending = {player, prompt, count, &describe};
+            swapcontext(&game_context, &caller_context);
+
+            if (abandoning)
+                throw SessionAbandoned();
+            return answer;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+transposition.h
+
+A fixed size table from the hash of a game state to a 64 bit value, that any number of threads can
+probe and store into without locking.
+*/
+
+#pragma once
+#ifndef GAMBIT_TRANSPOSITION_H
+#define GAMBIT_TRANSPOSITION_H
+
+#include "runtime.h"
+#include <atomic>
+#include <memory>
+
+namespace gambit
+{
+    // NOTE: Each entry stores its value alongside the hash XORed with the value. A probe only accepts
+    //       an entry when the two agree, so an entry torn by two threads storing at once is treated
+    //       as missing rather than returned with the wrong value. Entries are always replaced.
+    class TranspositionTable
+    {
+    public:
+        // The capacity is rounded up to a power of two
+        explicit TranspositionTable(size_t capacity)
+        {
+            size = 1;
+            while (size < capacity)
+                size <<= 1;
+            entries.reset(new Entry[size]);
+        }
+
+        bool probe(uint64_t hash, uint64_t &value) const
+        {
+            const Entry &entry = entries[hash & (size - 1)];
+            uint64_t check = entry.check.load(std::memory_order_relaxed);
+            uint64_t data = entry.data.load(std::memory_order_relaxed);
+            if ((check ^ data) != hash)
+                return false;
+
+            value = data;
+            return true;
+        }
+
+        void store(uint64_t hash, uint64_t value)
+        {
+            Entry &entry = entries[hash & (size - 1)];
+            entry.check.store(hash ^ value, std::memory_order_relaxed);
+            entry.data.store(value, std::memory_order_relaxed);
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                entries[i].check.store(0, std::memory_order_relaxed);
+                entries[i].data.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_t capacity() const { return size; }
+
+    private:
+        struct Entry
+        {
+            std::atomic<uint64_t> check{0};
+            std::atomic<uint64_t> data{0};
+        };
+
+        size_t size;
+        std::unique_ptr<Entry[]> entries;
+    };
+}
+
+#endif
@@ -1 +1 @@
-lua54 script/build.lua %*
\ No newline at end of file
+cmake -S . -B local/build -DCMAKE_BUILD_TYPE=Debug && cmake --build local/build %*
\ No newline at end of file
@@ -1 +1 @@
-gdb local\build\main
\ No newline at end of file
+gdb local\build\gambit
\ No newline at end of file
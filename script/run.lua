@@ -1,4 +1,4 @@
-local cmd = "local\\build\\main.exe"
+local cmd = "local\\build\\gambit.exe"
 if arg[1] then
     cmd = cmd .. " " .. arg[1]
 end